@@ -26,6 +26,7 @@
 =============================================================================*/
 
 #include <stdio.h>
+#include <string.h>
 #include "ALACBitUtilities.h"
 
 // BitBufferInit
@@ -255,6 +256,39 @@ void BitBufferWrite( BitBuffer * bits, uint32_t bitValues, uint32_t numBits )
 	bits->bitIndex = 8 - invBitIndex;
 }
 
+// BitBufferAppend
+// - bits must have room for one byte more than is appended
+//
+void BitBufferAppend( BitBuffer * bits, BitBuffer * src )
+{
+	uint8_t *		begin = src->end - src->byteSize;
+	uint32_t		numBytes = (uint32_t)(src->cur - begin);
+	uint32_t		shift = bits->bitIndex;
+	uint32_t		index;
+
+	if ( shift == 0 )
+	{
+		memcpy( bits->cur, begin, numBytes );
+		bits->cur += numBytes;
+	}
+	else
+	{
+		uint8_t *		dst = bits->cur;
+		uint8_t			keep = (uint8_t)(0xffu << (8 - shift));
+
+		for ( index = 0; index < numBytes; index++ )
+		{
+			dst[0] = (dst[0] & keep) | (begin[index] >> shift);
+			dst[1] = (uint8_t)(begin[index] << (8 - shift));
+			dst++;
+		}
+		bits->cur = dst;
+	}
+
+	if ( src->bitIndex != 0 )
+		BitBufferWrite( bits, begin[numBytes] >> (8 - src->bitIndex), src->bitIndex );
+}
+
 void	BitBufferReset( BitBuffer * bits )
 //void BitBufferInit( BitBuffer * bits, uint8_t * buffer, uint32_t byteSize )
 {
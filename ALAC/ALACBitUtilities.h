@@ -96,6 +96,7 @@ void	BitBufferAdvance( BitBuffer * bits, uint32_t numBits );
 void	BitBufferRewind( BitBuffer * bits, uint32_t numBits );
 void	BitBufferWrite( BitBuffer * bits, uint32_t value, uint32_t numBits );
 void	BitBufferReset( BitBuffer * bits);
+void	BitBufferAppend( BitBuffer * bits, BitBuffer * src );	// copies everything written to src so far
 
 
 #ifdef __cplusplus
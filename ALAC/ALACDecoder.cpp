@@ -54,6 +54,7 @@ ALACDecoder::ALACDecoder()
 	mMixBufferU = NULL; mMixBufferV = NULL;
 	mPredictor = NULL; mShiftBuffer = NULL;
 	mActiveElements = 0;
+	mAlignedOutput = false;
     memset(&mConfig,0,sizeof(mConfig));
 }
 
@@ -336,7 +337,14 @@ int32_t ALACDecoder::Decode( BitBuffer * bits, uint8_t * sampleBuffer, uint32_t
 				}
 
 				// convert 32-bit integers into output buffer
-				switch ( mConfig.bitDepth )
+				// - the packed 16/20-bit outputs ignore shifted bytes, and so does the aligned one
+				if ( mAlignedOutput )
+				{
+					out32 = &((int32_t *)sampleBuffer)[channelIndex];
+					copyPredictorToAligned32( mMixBufferU, mShiftBuffer, out32, numChannels, numSamples,
+											  (mConfig.bitDepth > 20) ? bytesShifted : 0, 32 - mConfig.bitDepth );
+				}
+				else switch ( mConfig.bitDepth )
 				{
 					case 16:
 						out16 = &((int16_t *)sampleBuffer)[channelIndex];
@@ -535,7 +543,13 @@ int32_t ALACDecoder::Decode( BitBuffer * bits, uint8_t * sampleBuffer, uint32_t
 
 				// un-mix the data and convert to output format
 				// - note that mixRes = 0 means just interleave so we use that path for uncompressed frames
-				switch ( mConfig.bitDepth )
+				if ( mAlignedOutput )
+				{
+					out32 = &((int32_t *)sampleBuffer)[channelIndex];
+					unmixAligned32( mMixBufferU, mMixBufferV, out32, numChannels, numSamples,
+									mixBits, mixRes, mShiftBuffer, (mConfig.bitDepth > 20) ? bytesShifted : 0, 32 - mConfig.bitDepth );
+				}
+				else switch ( mConfig.bitDepth )
 				{
 					case 16:
 						out16 = &((int16_t *)sampleBuffer)[channelIndex];
@@ -607,6 +621,11 @@ NoMoreChannels:
 	// if we get here and haven't decoded all of the requested channels, fill the remaining channels with zeros
 	for ( ; channelIndex < numChannels; channelIndex++ )
 	{
+		if ( mAlignedOutput )
+		{
+			Zero32( &((int32_t *)sampleBuffer)[channelIndex], numSamples, numChannels );
+			continue;
+		}
 		switch ( mConfig.bitDepth )
 		{
 			case 16:
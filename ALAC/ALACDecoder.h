@@ -44,6 +44,8 @@ class ALACDecoder
 
 		int32_t	Init( void * inMagicCookie, uint32_t inMagicCookieSize );
 		int32_t	Decode( struct BitBuffer * bits, uint8_t * sampleBuffer, uint32_t numSamples, uint32_t numChannels, uint32_t * outNumSamples );
+		// when set, Decode() writes every bit depth as 32-bit samples with the valid bits at the top
+		void	SetAlignedOutput( bool inAligned ) { mAlignedOutput = inAligned; }
 	public:
 		// decoding parameters (public for use in the analyzer)
 		ALACSpecificConfig		mConfig;
@@ -52,6 +54,7 @@ class ALACDecoder
 		int32_t	DataStreamElement( struct BitBuffer * bits );
 
 		uint16_t					mActiveElements;
+		bool						mAlignedOutput;
 
 		// decoding buffers
 		int32_t *				mMixBufferU;
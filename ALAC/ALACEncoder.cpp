@@ -54,6 +54,19 @@ const uint32_t kDefaultNumUV		= 8;
 const uint32_t kMinUV				= 4;
 const uint32_t kMaxUV				= 8;
 
+// search levels above the stock search (see SetSearchLevel()), numbered like --alac-level
+const int32_t  kSearchLevelStock	= 2;
+const int32_t  kSearchLevelWide	= 3;
+const int32_t  kSearchLevelMax	= 4;
+
+// wider ranges tried at the higher search levels
+const uint32_t kMaxSearchUV		= kALACMaxCoefs;
+const uint32_t kMaxMixBits		= 4;
+const uint32_t kMinDenShift		= 6;
+const uint32_t kMaxDenShift		= 13;
+const uint32_t kMinPBFactor		= 2;
+const uint32_t kMaxPBFactor		= 6;
+
 // static functions
 #if VERBOSE_DEBUG
 static void AddFiller( BitBuffer * bits, int32_t numBytes );
@@ -102,6 +115,8 @@ static const uint32_t sSupportediPodSampleRates[] =
 ALACEncoder::ALACEncoder() :
 	mBitDepth( 0 ),
     mFastMode( 0 ),
+    mEstimateMode( 0 ),
+    mSearchLevel( kSearchLevelStock ),
 	mMixBufferU( nil ),
 	mMixBufferV( nil ),
 	mPredictorU( nil ),
@@ -259,6 +274,250 @@ ALACEncoder::~ALACEncoder()
         in patent documents.
 */
 
+/*
+	TrialBits()
+	- size of the residuals in pc for the parameter searches: coded into workBits, or estimated
+*/
+int32_t ALACEncoder::TrialBits( BitBuffer * workBits, int32_t * pc, uint32_t numSamples, uint32_t chanBits, uint32_t pbFactor, uint32_t * outNumBits )
+{
+	AGParamRec		agParams;
+
+	if ( mEstimateMode )
+	{
+		*outNumBits = dyn_estimate( pc, numSamples, chanBits );
+		return ALAC_noErr;
+	}
+
+	set_ag_params( &agParams, MB0, (pbFactor * PB0) / 4, KB0, numSamples, numSamples, MAX_RUN_DEFAULT );
+	return dyn_comp( &agParams, pc, workBits, numSamples, chanBits, outNumBits );
+}
+
+/*
+	ScaleCoefs()
+	- convert predictor coefs between two denShift precisions; false if some had to be clipped to 16 bits
+*/
+static bool ScaleCoefs( const int16_t * src, int16_t * dst, uint32_t numCoefs, uint32_t fromShift, uint32_t toShift )
+{
+	uint32_t		index;
+	bool			exact = true;
+
+	for ( index = 0; index < numCoefs; index++ )
+	{
+		int32_t			val = src[index];
+
+		if ( toShift >= fromShift )
+			val *= (1 << (toShift - fromShift));
+		else
+			val >>= (fromShift - toShift);
+
+		if ( (val < INT16_MIN) || (val > INT16_MAX) )
+		{
+			val = (val < 0) ? INT16_MIN : INT16_MAX;
+			exact = false;
+		}
+		dst[index] = (int16_t) val;
+	}
+	return exact;
+}
+
+/*
+	SearchShape()
+	- for the higher search levels, pick the denShift and pbFactor for one channel's chosen predictor
+	- each trial runs the whole packet from a copy of the coefs, so the persistent coefs are left alone
+	- the best denShift tends to be at either end of the range (fast or slow adaptation), so level 3
+	  only tries every third one
+*/
+int32_t ALACEncoder::SearchShape( BitBuffer * workBits, int32_t * in, int32_t * pc, int16_t * coefs, uint32_t numCoefs,
+								  uint32_t numSamples, uint32_t chanBits, uint32_t * outDenShift, uint32_t * outPBFactor )
+{
+	int16_t			trialCoefs[kALACMaxCoefs];
+	uint32_t		bits, minBits;
+	uint32_t		denShift, pbFactor;
+	int32_t			status;
+
+	*outDenShift = DENSHIFT_DEFAULT;
+	*outPBFactor = 4;
+	minBits = 1ul << 31;
+
+	for ( denShift = kMinDenShift; denShift <= kMaxDenShift; denShift += (mSearchLevel >= kSearchLevelMax) ? 1 : 3 )
+	{
+		if ( !ScaleCoefs( coefs, trialCoefs, numCoefs, DENSHIFT_DEFAULT, denShift ) )
+			continue;
+
+		BitBufferInit( workBits, mWorkBuffer, mMaxOutputBytes );
+		pc_block( in, pc, numSamples, trialCoefs, numCoefs, chanBits, denShift );
+		status = TrialBits( workBits, pc, numSamples, chanBits, *outPBFactor, &bits );
+		RequireNoErr( status, return status; );
+
+		if ( bits < minBits )
+		{
+			minBits = bits;
+			*outDenShift = denShift;
+		}
+	}
+
+	// the residuals don't depend on pbFactor, so run the predictor once more with the best denShift
+	ScaleCoefs( coefs, trialCoefs, numCoefs, DENSHIFT_DEFAULT, *outDenShift );
+	pc_block( in, pc, numSamples, trialCoefs, numCoefs, chanBits, *outDenShift );
+
+	for ( pbFactor = kMinPBFactor; pbFactor <= kMaxPBFactor; pbFactor++ )
+	{
+		if ( pbFactor == 4 )
+			continue;
+
+		BitBufferInit( workBits, mWorkBuffer, mMaxOutputBytes );
+		status = TrialBits( workBits, pc, numSamples, chanBits, pbFactor, &bits );
+		RequireNoErr( status, return status; );
+
+		if ( bits < minBits )
+		{
+			minBits = bits;
+			*outPBFactor = pbFactor;
+		}
+	}
+
+	return ALAC_noErr;
+}
+
+/*
+	ConstantSample()
+	- true if every sample of one channel of the input is the same, and that sample in outValue (right-aligned)
+*/
+static bool ConstantSample( void * inputBuffer, uint32_t stride, uint32_t numSamples, uint32_t bitDepth, int32_t * outValue )
+{
+	uint32_t		index;
+
+	switch ( bitDepth )
+	{
+		case 16:
+		{
+			int16_t *		input16 = (int16_t *) inputBuffer;
+
+			for ( index = 1; index < numSamples; index++ )
+				if ( input16[index * stride] != input16[0] )
+					return false;
+			*outValue = input16[0];
+			break;
+		}
+		case 20:
+		case 24:
+		{
+			uint8_t *		input8 = (uint8_t *) inputBuffer;
+
+			for ( index = 1; index < numSamples; index++ )
+			{
+				uint8_t *		ip = input8 + index * stride * 3;
+
+				if ( (ip[0] != input8[0]) || (ip[1] != input8[1]) || (ip[2] != input8[2]) )
+					return false;
+			}
+			if ( bitDepth == 20 )
+				copy20ToPredictor( input8, stride, outValue, 1 );
+			else
+				copy24ToPredictor( input8, stride, outValue, 1 );
+			break;
+		}
+		case 32:
+		{
+			int32_t *		input32 = (int32_t *) inputBuffer;
+
+			for ( index = 1; index < numSamples; index++ )
+				if ( input32[index * stride] != input32[0] )
+					return false;
+			*outValue = input32[0];
+			break;
+		}
+		default:
+			return false;
+	}
+	return true;
+}
+
+/*
+	EncodeConstant()
+	- encode a mono or stereo element whose channels each hold a single value for the whole packet (typically
+	  digital silence) without any search: no mixing, at most a zero order-1 coef, so the residual is one value
+	  followed by zeros which dyn_comp codes as a single run
+	- no byte is shifted off below 32 bits, the shift buffer would cost more than the whole residual
+	- returns false (and writes nothing) if the input isn't constant or an escape packet would be smaller,
+	  the coefs and mix state are left alone either way
+*/
+bool ALACEncoder::EncodeConstant( BitBuffer * bitstream, void * inputBuffer, uint32_t stride, uint32_t numChannels, uint32_t numSamples )
+{
+	BitBuffer		startBits = *bitstream;
+	AGParamRec		agParams;
+	int32_t			values[2];
+	uint32_t		bytesPerSample;
+	uint32_t		bytesShifted;
+	uint32_t		shift;
+	uint32_t		chanBits;
+	uint32_t		partialFrame;
+	uint32_t		escapeBits;
+	uint32_t		bits;
+	uint32_t		index, channel;
+
+	if ( numSamples == 0 )
+		return false;
+
+	bytesPerSample = (mBitDepth == 16) ? 2 : (mBitDepth == 32) ? 4 : 3;
+	for ( channel = 0; channel < numChannels; channel++ )
+	{
+		if ( !ConstantSample( (uint8_t *) inputBuffer + channel * bytesPerSample, stride, numSamples, mBitDepth, &values[channel] ) )
+			return false;
+	}
+
+	// chanBits must stay within 32 bits, and mono-sized for stereo since there is no mixing
+	bytesShifted = (mBitDepth == 32) ? 1 : 0;
+	shift = bytesShifted * 8;
+	chanBits = mBitDepth - shift + ((numChannels == 2) ? 1 : 0);
+	partialFrame = (numSamples == mFrameSize) ? 0 : 1;
+
+	BitBufferWrite( bitstream, 0, 12 );
+	BitBufferWrite( bitstream, (partialFrame << 3) | (bytesShifted << 1), 4 );
+	if ( partialFrame )
+		BitBufferWrite( bitstream, numSamples, 32 );
+	BitBufferWrite( bitstream, 0, 16 );								// mixBits = mixRes = 0
+
+	for ( channel = 0; channel < numChannels; channel++ )
+	{
+		uint32_t		numU = ((values[channel] >> shift) != 0) ? 1 : 0;
+
+		BitBufferWrite( bitstream, (0 << 4) | DENSHIFT_DEFAULT, 8 );	// modeU = 0
+		BitBufferWrite( bitstream, (4 << 5) | numU, 8 );
+		if ( numU != 0 )
+			BitBufferWrite( bitstream, 0, 16 );
+	}
+
+	if ( bytesShifted != 0 )
+	{
+		for ( index = 0; index < numSamples; index++ )
+			for ( channel = 0; channel < numChannels; channel++ )
+				BitBufferWrite( bitstream, values[channel] & ((1u << shift) - 1), shift );
+	}
+
+	// with zero or one coef, a constant input predicts to its first sample followed by zeros
+	for ( channel = 0; channel < numChannels; channel++ )
+	{
+		mPredictorU[0] = values[channel] >> shift;
+		memset( &mPredictorU[1], 0, (numSamples - 1) * sizeof(int32_t) );
+
+		set_ag_params( &agParams, MB0, PB0, KB0, numSamples, numSamples, MAX_RUN_DEFAULT );
+		if ( dyn_comp( &agParams, mPredictorU, bitstream, numSamples, chanBits, &bits ) != ALAC_noErr )
+		{
+			*bitstream = startBits;
+			return false;
+		}
+	}
+
+	escapeBits = (numSamples * mBitDepth * numChannels) + ((partialFrame == true) ? 32 : 0) + (2 * 8);
+	if ( (BitBufferGetPosition( bitstream ) - BitBufferGetPosition( &startBits )) >= escapeBits )
+	{
+		*bitstream = startBits;
+		return false;
+	}
+	return true;
+}
+
 /*
 	EncodeStereo()
 	- encode a channel pair
@@ -273,13 +532,18 @@ int32_t ALACEncoder::EncodeStereo( BitBuffer * bitstream, void * inputBuffer, ui
 	int32_t			mixBits, mixRes, maxRes;
 	uint32_t			minBits, minBits1, minBits2;
 	uint32_t			numU, numV;
+	uint32_t			maxUV, stepUV;
 	uint32_t			mode;
 	uint32_t			pbFactor;
 	uint32_t			chanBits;
 	uint32_t			denShift;
+	uint32_t			denShiftU, denShiftV;
+	uint32_t			pbFactorU, pbFactorV;
 	uint8_t			bytesShifted;
 	SearchCoefs		coefsU;
 	SearchCoefs		coefsV;
+	int16_t			finalCoefsU[kALACMaxCoefs];
+	int16_t			finalCoefsV[kALACMaxCoefs];
 	uint32_t			index;
 	uint8_t			partialFrame;
 	uint32_t			escapeBits;
@@ -297,6 +561,10 @@ int32_t ALACEncoder::EncodeStereo( BitBuffer * bitstream, void * inputBuffer, ui
 	coefsU = (SearchCoefs) mCoefsU[channelIndex];
 	coefsV = (SearchCoefs) mCoefsV[channelIndex];
 
+	// silence and other constant input needs no search
+	if ( EncodeConstant( bitstream, inputBuffer, stride, 2, numSamples ) )
+		return ALAC_noErr;
+
 	// matrix encoding adds an extra bit but 32-bit inputs cannot be matrixed b/c 33 is too many
 	// so enable 16-bit "shift off" and encode in 17-bit mode
 	// - in addition, 24-bit mode really improves with one byte shifted off
@@ -325,8 +593,12 @@ int32_t ALACEncoder::EncodeStereo( BitBuffer * bitstream, void * inputBuffer, ui
 	minBits	= minBits1 = minBits2 = 1ul << 31;
 	
     int32_t		bestRes = mLastMixRes[channelIndex];
+    int32_t		bestMixBits = kDefaultMixBits;
+    int32_t		maxMixBits = (mSearchLevel >= kSearchLevelMax) ? kMaxMixBits : kDefaultMixBits;
 
-    for ( mixRes = 0; mixRes <= maxRes; mixRes++ )
+    // finer mixBits only add the odd mixRes values, the even ones repeat a coarser weight
+    for ( mixBits = kDefaultMixBits; mixBits <= maxMixBits; mixBits++ )
+    for ( mixRes = (mixBits == kDefaultMixBits) ? 0 : 1; mixRes <= (maxRes << (mixBits - kDefaultMixBits)); mixRes += (mixBits == kDefaultMixBits) ? 1 : 2 )
     {
         // mix the stereo inputs
         switch ( mBitDepth )
@@ -356,12 +628,10 @@ int32_t ALACEncoder::EncodeStereo( BitBuffer * bitstream, void * inputBuffer, ui
         pc_block( mMixBufferV, mPredictorV, numSamples/dilate, coefsV[numV - 1], numV, chanBits, DENSHIFT_DEFAULT );
 
         // run the lossless compressor on each channel
-        set_ag_params( &agParams, MB0, (pbFactor * PB0) / 4, KB0, numSamples/dilate, numSamples/dilate, MAX_RUN_DEFAULT );
-        status = dyn_comp( &agParams, mPredictorU, &workBits, numSamples/dilate, chanBits, &bits1 );
+        status = TrialBits( &workBits, mPredictorU, numSamples/dilate, chanBits, pbFactor, &bits1 );
         RequireNoErr( status, goto Exit; );
 
-        set_ag_params( &agParams, MB0, (pbFactor * PB0) / 4, KB0, numSamples/dilate, numSamples/dilate, MAX_RUN_DEFAULT );
-        status = dyn_comp( &agParams, mPredictorV, &workBits, numSamples/dilate, chanBits, &bits2 );
+        status = TrialBits( &workBits, mPredictorV, numSamples/dilate, chanBits, pbFactor, &bits2 );
         RequireNoErr( status, goto Exit; );
 
         // look for best match
@@ -369,12 +639,14 @@ int32_t ALACEncoder::EncodeStereo( BitBuffer * bitstream, void * inputBuffer, ui
         {
             minBits1 = bits1 + bits2;
             bestRes = mixRes;
+            bestMixBits = mixBits;
         }
     }
     
     mLastMixRes[channelIndex] = (int16_t)bestRes;
 
 	// mix the stereo inputs with the current best mixRes
+	mixBits = bestMixBits;
 	mixRes = mLastMixRes[channelIndex];
 	switch ( mBitDepth )
 	{
@@ -400,7 +672,10 @@ int32_t ALACEncoder::EncodeStereo( BitBuffer * bitstream, void * inputBuffer, ui
 	numU = numV = kMinUV;
 	minBits1 = minBits2 = 1ul << 31;
 
-	for ( uint32_t numUV = kMinUV; numUV <= kMaxUV; numUV += 4 )
+	maxUV	= (mSearchLevel >= kSearchLevelWide) ? kMaxSearchUV : kMaxUV;
+	stepUV	= (mSearchLevel >= kSearchLevelMax) ? 2 : 4;
+
+	for ( uint32_t numUV = kMinUV; numUV <= maxUV; numUV += stepUV )
 	{
 		BitBufferInit( &workBits, mWorkBuffer, mMaxOutputBytes );		
 
@@ -415,8 +690,7 @@ int32_t ALACEncoder::EncodeStereo( BitBuffer * bitstream, void * inputBuffer, ui
 
 		dilate = 8;
 
-		set_ag_params( &agParams, MB0, (pbFactor * PB0)/4, KB0, numSamples/dilate, numSamples/dilate, MAX_RUN_DEFAULT );
-		status = dyn_comp( &agParams, mPredictorU, &workBits, numSamples/dilate, chanBits, &bits1 );
+		status = TrialBits( &workBits, mPredictorU, numSamples/dilate, chanBits, pbFactor, &bits1 );
 
 		if ( (bits1 * dilate + 16 * numUV) < minBits1 )
 		{
@@ -424,8 +698,7 @@ int32_t ALACEncoder::EncodeStereo( BitBuffer * bitstream, void * inputBuffer, ui
 			numU = numUV;
 		}
 
-		set_ag_params( &agParams, MB0, (pbFactor * PB0)/4, KB0, numSamples/dilate, numSamples/dilate, MAX_RUN_DEFAULT );
-		status = dyn_comp( &agParams, mPredictorV, &workBits, numSamples/dilate, chanBits, &bits2 );
+		status = TrialBits( &workBits, mPredictorV, numSamples/dilate, chanBits, pbFactor, &bits2 );
 
 		if ( (bits2 * dilate + 16 * numUV) < minBits2 )
 		{
@@ -434,7 +707,21 @@ int32_t ALACEncoder::EncodeStereo( BitBuffer * bitstream, void * inputBuffer, ui
 		}
 	}
 
+	denShiftU = denShiftV = DENSHIFT_DEFAULT;
+	pbFactorU = pbFactorV = pbFactor;
+	if ( mSearchLevel >= kSearchLevelWide )
+	{
+		status = SearchShape( &workBits, mMixBufferU, mPredictorU, coefsU[numU - 1], numU, numSamples, chanBits, &denShiftU, &pbFactorU );
+		RequireNoErr( status, goto Exit; );
+		status = SearchShape( &workBits, mMixBufferV, mPredictorV, coefsV[numV - 1], numV, numSamples, chanBits, &denShiftV, &pbFactorV );
+		RequireNoErr( status, goto Exit; );
+	}
+	ScaleCoefs( coefsU[numU - 1], finalCoefsU, numU, DENSHIFT_DEFAULT, denShiftU );
+	ScaleCoefs( coefsV[numV - 1], finalCoefsV, numV, DENSHIFT_DEFAULT, denShiftV );
+
 	// test for escape hatch if best calculated compressed size turns out to be more than the input size
+	// - there is no earlier escape on purpose: the search adapts the coefs in place, so skipping it for
+	//   noise-like input would change the packets that follow
 	minBits = minBits1 + minBits2 + (8 /* mixRes/maxRes/etc. */ * 8) + ((partialFrame == true) ? 32 : 0);
 	if ( bytesShifted != 0 )
 		minBits += (numSamples * (bytesShifted * 8) * 2);
@@ -457,15 +744,15 @@ int32_t ALACEncoder::EncodeStereo( BitBuffer * bitstream, void * inputBuffer, ui
 		//Assert( (pbFactor < 8) && (numU < 32) );
 		//Assert( (pbFactor < 8) && (numV < 32) );
 
-		BitBufferWrite( bitstream, (mode << 4) | DENSHIFT_DEFAULT, 8 );
-		BitBufferWrite( bitstream, (pbFactor << 5) | numU, 8 );
+		BitBufferWrite( bitstream, (mode << 4) | denShiftU, 8 );
+		BitBufferWrite( bitstream, (pbFactorU << 5) | numU, 8 );
 		for ( index = 0; index < numU; index++ )
-			BitBufferWrite( bitstream, coefsU[numU - 1][index], 16 );
+			BitBufferWrite( bitstream, finalCoefsU[index], 16 );
 
-		BitBufferWrite( bitstream, (mode << 4) | DENSHIFT_DEFAULT, 8 );
-		BitBufferWrite( bitstream, (pbFactor << 5) | numV, 8 );
+		BitBufferWrite( bitstream, (mode << 4) | denShiftV, 8 );
+		BitBufferWrite( bitstream, (pbFactorV << 5) | numV, 8 );
 		for ( index = 0; index < numV; index++ )
-			BitBufferWrite( bitstream, coefsV[numV - 1][index], 16 );
+			BitBufferWrite( bitstream, finalCoefsV[index], 16 );
 
 		// if shift active, write the interleaved shift buffers
 		if ( bytesShifted != 0 )
@@ -488,33 +775,37 @@ int32_t ALACEncoder::EncodeStereo( BitBuffer * bitstream, void * inputBuffer, ui
 		//		   of only using "U" buffers for the U-channel and "V" buffers for the V-channel
 		if ( mode == 0 )
 		{
-			pc_block( mMixBufferU, mPredictorU, numSamples, coefsU[numU - 1], numU, chanBits, DENSHIFT_DEFAULT );
+			pc_block( mMixBufferU, mPredictorU, numSamples, finalCoefsU, numU, chanBits, denShiftU );
 		}
 		else
 		{
-			pc_block( mMixBufferU, mPredictorV, numSamples, coefsU[numU - 1], numU, chanBits, DENSHIFT_DEFAULT );
+			pc_block( mMixBufferU, mPredictorV, numSamples, finalCoefsU, numU, chanBits, denShiftU );
 			pc_block( mPredictorV, mPredictorU, numSamples, nil, 31, chanBits, 0 );
 		}
 
-		set_ag_params( &agParams, MB0, (pbFactor * PB0) / 4, KB0, numSamples, numSamples, MAX_RUN_DEFAULT );
+		set_ag_params( &agParams, MB0, (pbFactorU * PB0) / 4, KB0, numSamples, numSamples, MAX_RUN_DEFAULT );
 		status = dyn_comp( &agParams, mPredictorU, bitstream, numSamples, chanBits, &bits1 );
 		RequireNoErr( status, goto Exit; );
 
 		// run the dynamic predictor and lossless compression for the "right" channel
 		if ( mode == 0 )
 		{
-			pc_block( mMixBufferV, mPredictorV, numSamples, coefsV[numV - 1], numV, chanBits, DENSHIFT_DEFAULT );
+			pc_block( mMixBufferV, mPredictorV, numSamples, finalCoefsV, numV, chanBits, denShiftV );
 		}
 		else
 		{
-			pc_block( mMixBufferV, mPredictorU, numSamples, coefsV[numV - 1], numV, chanBits, DENSHIFT_DEFAULT );
+			pc_block( mMixBufferV, mPredictorU, numSamples, finalCoefsV, numV, chanBits, denShiftV );
 			pc_block( mPredictorU, mPredictorV, numSamples, nil, 31, chanBits, 0 );
 		}
 
-		set_ag_params( &agParams, MB0, (pbFactor * PB0) / 4, KB0, numSamples, numSamples, MAX_RUN_DEFAULT );
+		set_ag_params( &agParams, MB0, (pbFactorV * PB0) / 4, KB0, numSamples, numSamples, MAX_RUN_DEFAULT );
 		status = dyn_comp( &agParams, mPredictorV, bitstream, numSamples, chanBits, &bits2 );
 		RequireNoErr( status, goto Exit; );
 
+		// carry the adapted coefs over to the next packet
+		ScaleCoefs( finalCoefsU, coefsU[numU - 1], numU, denShiftU, DENSHIFT_DEFAULT );
+		ScaleCoefs( finalCoefsV, coefsV[numV - 1], numV, denShiftV, DENSHIFT_DEFAULT );
+
 		/*	if we happened to create a compressed packet that was actually bigger than an escape packet would be,
 			chuck it and do an escape packet
 		*/
@@ -579,6 +870,9 @@ int32_t ALACEncoder::EncodeStereoFast( BitBuffer * bitstream, void * inputBuffer
 	coefsU = (SearchCoefs) mCoefsU[channelIndex];
 	coefsV = (SearchCoefs) mCoefsV[channelIndex];
 
+	if ( EncodeConstant( bitstream, inputBuffer, stride, 2, numSamples ) )
+		return ALAC_noErr;
+
 	// matrix encoding adds an extra bit but 32-bit inputs cannot be matrixed b/c 33 is too many
 	// so enable 16-bit "shift off" and encode in 17-bit mode
 	// - in addition, 24-bit mode really improves with one byte shifted off
@@ -811,7 +1105,9 @@ int32_t ALACEncoder::EncodeMono( BitBuffer * bitstream, void * inputBuffer, uint
 	uint32_t			shift;
 	uint32_t			mask;
 	uint32_t			chanBits;
-	uint8_t			pbFactor;
+	uint32_t			pbFactor;
+	uint32_t			denShift;
+	int16_t			finalCoefsU[kALACMaxCoefs];
 	uint8_t			partialFrame;
 	int16_t *		input16;
 	int32_t *		input32;
@@ -827,6 +1123,10 @@ int32_t ALACEncoder::EncodeMono( BitBuffer * bitstream, void * inputBuffer, uint
 	// reload coefs array from previous frame
 	coefsU = (SearchCoefs) mCoefsU[channelIndex];
 
+	// silence and other constant input needs no search
+	if ( EncodeConstant( bitstream, inputBuffer, stride, 1, numSamples ) )
+		return ALAC_noErr;
+
 	// pick bit depth for actual encoding
 	// - we lop off the lower byte(s) for 24-/32-bit encodings
 	if ( mBitDepth == 32 )
@@ -886,14 +1186,14 @@ int32_t ALACEncoder::EncodeMono( BitBuffer * bitstream, void * inputBuffer, uint
 	// brute-force encode optimization loop (implied "encode depth" of 0 if comparing to cmd line tool)
 	// - run over variations of the encoding params to find the best choice
 	minU		= 4;
-	maxU		= 8;
+	maxU		= (mSearchLevel >= kSearchLevelWide) ? kMaxSearchUV : kMaxUV;
 	minBits		= 1ul << 31;
 	pbFactor	= 4;
 	
 	minBits	= 1ul << 31;
 	bestU	= minU;
 
-	for ( numU = minU; numU <= maxU; numU += 4 )
+	for ( numU = minU; numU <= maxU; numU += (mSearchLevel >= kSearchLevelMax) ? 2 : 4 )
 	{
 		BitBuffer		workBits;
 		uint32_t			numBits;
@@ -907,8 +1207,7 @@ int32_t ALACEncoder::EncodeMono( BitBuffer * bitstream, void * inputBuffer, uint
 		dilate = 8;
 		pc_block( mMixBufferU, mPredictorU, numSamples/dilate, coefsU[numU-1], numU, chanBits, DENSHIFT_DEFAULT );
 
-		set_ag_params( &agParams, MB0, (pbFactor * PB0) / 4, KB0, numSamples/dilate, numSamples/dilate, MAX_RUN_DEFAULT );
-		status = dyn_comp( &agParams, mPredictorU, &workBits, numSamples/dilate, chanBits, &bits1 );
+		status = TrialBits( &workBits, mPredictorU, numSamples/dilate, chanBits, pbFactor, &bits1 );
 		RequireNoErr( status, goto Exit; );
 
 		numBits = (dilate * bits1) + (16 * numU);
@@ -919,7 +1218,18 @@ int32_t ALACEncoder::EncodeMono( BitBuffer * bitstream, void * inputBuffer, uint
 		}
 	}             
 
+	denShift = DENSHIFT_DEFAULT;
+	if ( mSearchLevel >= kSearchLevelWide )
+	{
+		BitBuffer		workBits;
+
+		status = SearchShape( &workBits, mMixBufferU, mPredictorU, coefsU[bestU - 1], bestU, numSamples, chanBits, &denShift, &pbFactor );
+		RequireNoErr( status, goto Exit; );
+	}
+	ScaleCoefs( coefsU[bestU - 1], finalCoefsU, bestU, DENSHIFT_DEFAULT, denShift );
+
 	// test for escape hatch if best calculated compressed size turns out to be more than the input size
+	// (not any earlier, see EncodeStereo())
 	// - first, add bits for the header bytes mixRes/maxRes/shiftU/filterU
 	minBits += (4 /* mixRes/maxRes/etc. */ * 8) + ((partialFrame == true) ? 32 : 0);
 	if ( bytesShifted != 0 )
@@ -940,10 +1250,10 @@ int32_t ALACEncoder::EncodeMono( BitBuffer * bitstream, void * inputBuffer, uint
 		
 		// write the params and predictor coefs
 		numU = bestU;
-		BitBufferWrite( bitstream, (0 << 4) | DENSHIFT_DEFAULT, 8 );	// modeU = 0
+		BitBufferWrite( bitstream, (0 << 4) | denShift, 8 );	// modeU = 0
 		BitBufferWrite( bitstream, (pbFactor << 5) | numU, 8 );
 		for ( index = 0; index < numU; index++ )
-			BitBufferWrite( bitstream, coefsU[numU-1][index], 16 );
+			BitBufferWrite( bitstream, finalCoefsU[index], 16 );
 
 		// if shift active, write the interleaved shift buffers
 		if ( bytesShifted != 0 )
@@ -953,10 +1263,11 @@ int32_t ALACEncoder::EncodeMono( BitBuffer * bitstream, void * inputBuffer, uint
 		}
 
 		// run the dynamic predictor with the best result
-		pc_block( mMixBufferU, mPredictorU, numSamples, coefsU[numU-1], numU, chanBits, DENSHIFT_DEFAULT );
+		pc_block( mMixBufferU, mPredictorU, numSamples, finalCoefsU, numU, chanBits, denShift );
+		ScaleCoefs( finalCoefsU, coefsU[numU-1], numU, denShift, DENSHIFT_DEFAULT );
 
 		// do lossless compression
-		set_standard_ag_params( &agParams, numSamples, numSamples );
+		set_ag_params( &agParams, MB0, (pbFactor * PB0) / 4, KB0, numSamples, numSamples, MAX_RUN_DEFAULT );
 		status = dyn_comp( &agParams, mPredictorU, bitstream, numSamples, chanBits, &bits1 );
 		//AssertNoErr( status );
 
@@ -1030,7 +1341,6 @@ int32_t ALACEncoder::Encode(AudioFormatDescription theInputFormat, AudioFormatDe
                              unsigned char * theReadBuffer, unsigned char * theWriteBuffer, int32_t * ioNumBytes)
 {
 	uint32_t				numFrames;
-	uint32_t				outputSize;
 	BitBuffer			bitstream;
 	int32_t			status;
 
@@ -1064,94 +1374,122 @@ int32_t ALACEncoder::Encode(AudioFormatDescription theInputFormat, AudioFormatDe
 	}
 	else
 	{
-		char *					inputBuffer;
-		uint32_t				tag;
 		uint32_t				channelIndex;
-		uint32_t				inputIncrement;
-		uint8_t				stereoElementTag;
-		uint8_t				monoElementTag;
-		uint8_t				lfeElementTag;
-		
-		inputBuffer		= (char *) theReadBuffer;
-		inputIncrement	= ((mBitDepth + 7) / 8);
-		
-		stereoElementTag	= 0;
-		monoElementTag		= 0;
-		lfeElementTag		= 0;
+		uint32_t				numChannels;
 
-		for ( channelIndex = 0; channelIndex < theInputFormat.mChannelsPerFrame; )
+		for ( channelIndex = 0; channelIndex < theInputFormat.mChannelsPerFrame; channelIndex += numChannels )
 		{
-			tag = (sChannelMaps[theInputFormat.mChannelsPerFrame - 1] & (0x7ul << (channelIndex * 3))) >> (channelIndex * 3);
-	
-			BitBufferWrite( &bitstream, tag, 3 );
-			switch ( tag )
-			{
-				case ID_SCE:
-					// mono
-					BitBufferWrite( &bitstream, monoElementTag, 4 );
+			status = this->EncodeElement( &bitstream, theInputFormat, theReadBuffer, channelIndex, numFrames, &numChannels );
+			RequireNoErr( status, goto Exit; );
+		}
+	}
+
+	status = this->FinishFrame( &bitstream, ioNumBytes );
+
+Exit:
+	return status;
+}
 
-					status = this->EncodeMono( &bitstream, inputBuffer, theInputFormat.mChannelsPerFrame, channelIndex, numFrames );
-					
-					inputBuffer += inputIncrement;
-					channelIndex++;
-					monoElementTag++;
-					break;
+/*
+	GetElementChannels()
+	- number of channels (1 or 2) in the element that starts at channelIndex, 0 if there is none
+*/
+uint32_t ALACEncoder::GetElementChannels( uint32_t numChannels, uint32_t channelIndex )
+{
+	uint32_t		tag;
 
-				case ID_CPE:
-					// stereo
-					BitBufferWrite( &bitstream, stereoElementTag, 4 );
+	if ( (numChannels == 0) || (numChannels > kALACMaxChannels) || (channelIndex >= numChannels) )
+		return 0;
 
-					status = this->EncodeStereo( &bitstream, inputBuffer, theInputFormat.mChannelsPerFrame, channelIndex, numFrames );
+	tag = (sChannelMaps[numChannels - 1] >> (channelIndex * 3)) & 0x7u;
+	return (tag == ID_CPE) ? 2 : 1;
+}
 
-					inputBuffer += (inputIncrement * 2);
-					channelIndex += 2;
-					stereoElementTag++;
-					break;
+/*
+	EncodeElement()
+	- encode the SCE/CPE/LFE element of a multichannel packet that starts at channelIndex, tag included
+*/
+int32_t ALACEncoder::EncodeElement( BitBuffer * bitstream, AudioFormatDescription theInputFormat, unsigned char * theReadBuffer,
+									uint32_t channelIndex, uint32_t numFrames, uint32_t * outNumChannels )
+{
+	char *					inputBuffer;
+	uint32_t				map;
+	uint32_t				tag;
+	uint32_t				index;
+	uint8_t					elementTag;
+	int32_t					status;
+
+	map			= sChannelMaps[theInputFormat.mChannelsPerFrame - 1];
+	tag			= (map >> (channelIndex * 3)) & 0x7u;
+	inputBuffer	= (char *) theReadBuffer + channelIndex * ((mBitDepth + 7) / 8);
+
+	// the element instance tag counts the earlier elements of the same type
+	// - the map has a field per channel, and the second field of a CPE is ID_SCE (0), so skip over it
+	elementTag = 0;
+	for ( index = 0; index < channelIndex; index += ((((map >> (index * 3)) & 0x7u) == ID_CPE) ? 2 : 1) )
+	{
+		if ( ((map >> (index * 3)) & 0x7u) == tag )
+			elementTag++;
+	}
 
-				case ID_LFE:
-					// LFE channel (subwoofer)
-					BitBufferWrite( &bitstream, lfeElementTag, 4 );
+	BitBufferWrite( bitstream, tag, 3 );
+	BitBufferWrite( bitstream, elementTag, 4 );
 
-					status = this->EncodeMono( &bitstream, inputBuffer, theInputFormat.mChannelsPerFrame, channelIndex, numFrames );
+	switch ( tag )
+	{
+		case ID_SCE:
+		case ID_LFE:
+			// mono, or LFE channel (subwoofer)
+			status = this->EncodeMono( bitstream, inputBuffer, theInputFormat.mChannelsPerFrame, channelIndex, numFrames );
+			*outNumChannels = 1;
+			break;
 
-					inputBuffer += inputIncrement;
-					channelIndex++;
-					lfeElementTag++;
-					break;
+		case ID_CPE:
+			// stereo
+			status = this->EncodeStereo( bitstream, inputBuffer, theInputFormat.mChannelsPerFrame, channelIndex, numFrames );
+			*outNumChannels = 2;
+			break;
 
-				default:
+		default:
 #if VERBOSE_DEBUG
-					DebugMsg( "That ain't right! (%u)\n", tag );
+			DebugMsg( "That ain't right! (%u)\n", tag );
 #endif
-					status = kALAC_ParamError;
-					goto Exit;
-			}
-
-			RequireNoErr( status, goto Exit; );
-		}
+			status = kALAC_ParamError;
+			break;
 	}
 
+	return status;
+}
+
+/*
+	FinishFrame()
+	- terminate the packet in bitstream and return its size in bytes
+*/
+int32_t ALACEncoder::FinishFrame( BitBuffer * bitstream, int32_t * ioNumBytes )
+{
+	uint32_t				outputSize;
+
 #if VERBOSE_DEBUG
 {
 	// if there is room left in the output buffer, add some random fill data to test decoder
 	int32_t			bitsLeft;
 	int32_t			bytesLeft;
 	
-	bitsLeft = BitBufferGetPosition( &bitstream ) - 3;	// - 3 for ID_END tag
-	bytesLeft = bitstream.byteSize - ((bitsLeft + 7) / 8);
+	bitsLeft = BitBufferGetPosition( bitstream ) - 3;	// - 3 for ID_END tag
+	bytesLeft = bitstream->byteSize - ((bitsLeft + 7) / 8);
 	
 	if ( (bytesLeft > 20) && ((bytesLeft & 0x4u) != 0) )
-		AddFiller( &bitstream, bytesLeft );
+		AddFiller( bitstream, bytesLeft );
 }
 #endif
 
 	// add 3-bit frame end tag: ID_END
-	BitBufferWrite( &bitstream, ID_END, 3 );
+	BitBufferWrite( bitstream, ID_END, 3 );
 
 	// byte-align the output data
-	BitBufferByteAlign( &bitstream, true );
+	BitBufferByteAlign( bitstream, true );
 
-	outputSize = BitBufferGetPosition( &bitstream ) / 8;
+	outputSize = BitBufferGetPosition( bitstream ) / 8;
 	//Assert( outputSize <= mMaxOutputBytes );
 
 
@@ -1163,10 +1501,7 @@ int32_t ALACEncoder::Encode(AudioFormatDescription theInputFormat, AudioFormatDe
 	mTotalBytesGenerated += outputSize;
 	mMaxFrameBytes = MAX( mMaxFrameBytes, outputSize );
 
-	status = ALAC_noErr;
-
-Exit:
-	return status;
+	return ALAC_noErr;
 }
 
 /*
@@ -1280,15 +1615,15 @@ int32_t ALACEncoder::InitializeEncoder(AudioFormatDescription theOutputFormat)
             break;
     }
 
-	// set up default encoding parameters and state
+	// set up default encoding parameters
 	// - note: mFrameSize is set in the constructor or via SetFrameSize() which must be called before this routine
-	for ( uint32_t index = 0; index < kALACMaxChannels; index++ )
-		mLastMixRes[index] = kDefaultMixRes;
 
-	// the maximum output frame size can be no bigger than (samplesPerBlock * numChannels * ((10 + sampleSize)/8) + 1)
+	// the maximum output frame size can be no bigger than (samplesPerBlock * numChannels * ((10 + sampleSize + 7)/8) + 1)
 	// but note that this can be bigger than the input size!
 	// - since we don't yet know what our input format will be, use our max allowed sample size in the calculation
-	mMaxOutputBytes = mFrameSize * mNumChannels * ((10 + kMaxSampleSize) / 8)  + 1;
+	// - round up: a speculatively written 32-bit stereo frame of noise (shifted-off bytes plus escaped residuals)
+	//	 takes 42 bits per sample before it is thrown away for an escape packet
+	mMaxOutputBytes = mFrameSize * mNumChannels * ((10 + kMaxSampleSize + 7) / 8)  + 1;
 
 	// allocate mix buffers
 	mMixBufferU = (int32_t *) calloc( mFrameSize * sizeof(int32_t), 1 );
@@ -1311,8 +1646,23 @@ int32_t ALACEncoder::InitializeEncoder(AudioFormatDescription theOutputFormat)
 
 	status = ALAC_noErr;
 
-
 	// initialize coefs arrays once b/c retaining state across blocks actually improves the encode ratio
+	ResetState();
+
+Exit:
+	return status;
+}
+
+/*
+	ResetState()
+	- restore the state carried across blocks (last mixRes, predictor coefs) to the initial values
+	- the following blocks are then encoded as if they were at the beginning of the stream
+*/
+void ALACEncoder::ResetState()
+{
+	for ( uint32_t index = 0; index < kALACMaxChannels; index++ )
+		mLastMixRes[index] = kDefaultMixRes;
+
 	for ( int32_t channel = 0; channel < (int32_t)mNumChannels; channel++ )
 	{
 		for ( int32_t search = 0; search < kALACMaxSearches; search++ )
@@ -1321,9 +1671,6 @@ int32_t ALACEncoder::InitializeEncoder(AudioFormatDescription theOutputFormat)
 			init_coefs( mCoefsV[channel][search], DENSHIFT_DEFAULT, kALACMaxCoefs );
 		}
 	}
-
-Exit:
-	return status;
 }
 
 /*
@@ -42,8 +42,25 @@ class ALACEncoder
                                    unsigned char * theReadBuffer, unsigned char * theWriteBuffer, int32_t * ioNumBytes);
 		virtual int32_t	Finish( );
 
+		// multichannel packets can also be put together one element at a time, e.g. on several threads:
+		// EncodeElement() writes the element that starts at channelIndex, tag included, and FinishFrame() ends the packet
+		// - the predictor state is kept per element, so an element must always be encoded by the same ALACEncoder
+		static uint32_t		GetElementChannels( uint32_t numChannels, uint32_t channelIndex );
+		int32_t				EncodeElement( struct BitBuffer * bitstream, AudioFormatDescription theInputFormat, unsigned char * theReadBuffer,
+										   uint32_t channelIndex, uint32_t numFrames, uint32_t * outNumChannels );
+		int32_t				FinishFrame( struct BitBuffer * bitstream, int32_t * ioNumBytes );
+
 		void				SetFastMode( bool fast ) { mFastMode = fast; };
 
+		// price the candidates of the mixRes and predictor order searches with dyn_estimate() instead of
+		// trial dyn_comp() runs
+		void				SetEstimateMode( bool estimate ) { mEstimateMode = estimate; };
+
+		// numbered like --alac-level: 2 (default) is the stock search; 3 adds predictor orders up to
+		// kALACMaxCoefs and picks denShift/pbFactor per channel; 4 also tries finer mixBits and every
+		// even predictor order
+		void				SetSearchLevel( int32_t level ) { mSearchLevel = level; };
+
 		// this must be called *before* InitializeEncoder()
 		void				SetFrameSize( uint32_t frameSize ) { mFrameSize = frameSize; };
 
@@ -52,6 +69,7 @@ class ALACEncoder
         void				GetMagicCookie( void * config, uint32_t * ioSize ); 
 
         virtual int32_t	InitializeEncoder(AudioFormatDescription theOutputFormat);
+		void				ResetState();
 		uint32_t			GetMaxOutputBytes() {return mMaxOutputBytes;}
     protected:
 		virtual void		GetSourceFormat( const AudioFormatDescription * source, AudioFormatDescription * output );
@@ -59,12 +77,18 @@ class ALACEncoder
 		int32_t			EncodeStereo( struct BitBuffer * bitstream, void * input, uint32_t stride, uint32_t channelIndex, uint32_t numSamples );
 		int32_t			EncodeStereoFast( struct BitBuffer * bitstream, void * input, uint32_t stride, uint32_t channelIndex, uint32_t numSamples );
 		int32_t			EncodeStereoEscape( struct BitBuffer * bitstream, void * input, uint32_t stride, uint32_t numSamples );
+		bool			EncodeConstant( struct BitBuffer * bitstream, void * input, uint32_t stride, uint32_t numChannels, uint32_t numSamples );
 		int32_t			EncodeMono( struct BitBuffer * bitstream, void * input, uint32_t stride, uint32_t channelIndex, uint32_t numSamples );
+		int32_t			TrialBits( struct BitBuffer * workBits, int32_t * pc, uint32_t numSamples, uint32_t chanBits, uint32_t pbFactor, uint32_t * outNumBits );
+		int32_t			SearchShape( struct BitBuffer * workBits, int32_t * in, int32_t * pc, int16_t * coefs, uint32_t numCoefs,
+									 uint32_t numSamples, uint32_t chanBits, uint32_t * outDenShift, uint32_t * outPBFactor );
 
 
 		// ALAC encoder parameters
 		int16_t					mBitDepth;
 		bool					mFastMode;
+		bool					mEstimateMode;
+		int32_t					mSearchLevel;
 
 		// encoding state
 		int16_t					mLastMixRes[kALACMaxChannels];
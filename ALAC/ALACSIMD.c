@@ -0,0 +1,85 @@
+/*
+	File:		ALACSIMD.c
+
+	Contains:	CPU feature detection for the SIMD code paths.
+*/
+
+#include "ALACSIMD.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if ALAC_SIMD_X86 && defined(_MSC_VER)
+#include <immintrin.h>
+#endif
+
+// set in the cached feature word once detection has run
+#define kALACCPUDetected	0x80000000u
+
+static uint32_t DetectCPUFeatures( void )
+{
+	uint32_t	features = 0;
+
+#if ALAC_SIMD_X86 && defined(_MSC_VER)
+	int			info[4];
+	int			maxLeaf;
+
+	__cpuid( info, 0 );
+	maxLeaf = info[0];
+	if ( maxLeaf >= 1 )
+	{
+		__cpuid( info, 1 );
+		if ( info[2] & (1 << 19) )
+			features |= kALACCPUSSE41;
+		// AVX2 needs OS support for the YMM state as well
+		if ( (info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+			 (_xgetbv( 0 ) & 6) == 6 && maxLeaf >= 7 )
+		{
+			__cpuidex( info, 7, 0 );
+			if ( info[1] & (1 << 5) )
+				features |= kALACCPUAVX2;
+		}
+	}
+#elif ALAC_SIMD_X86
+	__builtin_cpu_init();
+	if ( __builtin_cpu_supports( "sse4.1" ) )
+		features |= kALACCPUSSE41;
+	if ( __builtin_cpu_supports( "avx2" ) )
+		features |= kALACCPUAVX2;
+#endif
+
+	{
+		const char *	cap = getenv( "ALAC_SIMD" );
+
+		if ( cap && !strcmp( cap, "none" ) )
+			features = 0;
+		else if ( cap && !strcmp( cap, "sse4.1" ) )
+			features &= kALACCPUSSE41;
+	}
+	return features;
+}
+
+uint32_t ALACGetCPUFeatures( void )
+{
+	// a single word accessed atomically: threads racing on the first call each detect and store the same value
+	static uint32_t		sFeatures = 0;
+	uint32_t			features;
+
+#if defined(_MSC_VER)
+	features = (uint32_t) _InterlockedOr( (volatile long *) &sFeatures, 0 );
+#else
+	features = __atomic_load_n( &sFeatures, __ATOMIC_ACQUIRE );
+#endif
+	if ( !(features & kALACCPUDetected) )
+	{
+		features = DetectCPUFeatures() | kALACCPUDetected;
+#if defined(_MSC_VER)
+		_InterlockedExchange( (volatile long *) &sFeatures, (long) features );
+#else
+		__atomic_store_n( &sFeatures, features, __ATOMIC_RELEASE );
+#endif
+	}
+	return features & ~kALACCPUDetected;
+}
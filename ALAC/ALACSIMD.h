@@ -0,0 +1,46 @@
+/*
+	File:		ALACSIMD.h
+
+	Contains:	CPU feature detection for the SIMD code paths.
+				Each SIMD routine is bit-exact with its scalar counterpart,
+				and is picked at run time.
+*/
+
+#ifndef __ALACSIMD_H
+#define __ALACSIMD_H
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ALAC_SIMD_X86 1
+#else
+#define ALAC_SIMD_X86 0
+#endif
+
+#if ALAC_SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define ALAC_TARGET_SSE41	__attribute__((target("sse4.1")))
+#define ALAC_TARGET_AVX2	__attribute__((target("avx2")))
+#else
+#define ALAC_TARGET_SSE41
+#define ALAC_TARGET_AVX2
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum
+{
+	kALACCPUSSE41	= 1 << 0,
+	kALACCPUAVX2	= 1 << 1
+};
+
+// set of kALACCPUxxx flags usable on this machine
+// the environment variable ALAC_SIMD=none or ALAC_SIMD=sse4.1 caps them, for testing
+uint32_t ALACGetCPUFeatures( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* __ALACSIMD_H */
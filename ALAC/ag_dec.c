@@ -101,7 +101,8 @@ static int32_t lead(int32_t m) {
 }
 #elif defined(__llvm__) || defined(__GNUC__)
 static inline int32_t lead(int32_t m) {
-	return __builtin_clz(m);
+	// lead(0) is reached after a maximal zero run
+	return m ? __builtin_clz(m) : 32;
 }
 #else
 // note: implementing this with some kind of "count leading zeros" assembly is a big performance win
@@ -144,34 +145,36 @@ static /*inline*/ uint32_t ALWAYS_INLINE read32bit( uint8_t * buffer )
 
 }
 
-static /*inline*/ uint32_t ALWAYS_INLINE read32bit_ex( uint8_t * buffer, uint8_t * end )
+// big-endian 64-bit load, zero-filled past the end of the buffer
+static /*inline*/ uint64_t ALWAYS_INLINE read64bit_ex( uint8_t * buffer, uint8_t * end )
 {
-	uint32_t		value ;
-#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
-	if (buffer + 4 <= end) {
-		return Swap32BtoN(*(uint32_t*)buffer);
-	}
+	uint64_t		value;
+	int32_t			i;
+
+	if (buffer + 8 <= end) {
+		memcpy(&value, buffer, sizeof(value));
+#if TARGET_RT_BIG_ENDIAN
+		return value;
+#elif defined(_MSC_VER)
+		return _byteswap_uint64(value);
+#else
+		return __builtin_bswap64(value);
 #endif
-	// embedded CPUs typically can't read unaligned 32-bit words so just read the bytes
-	value = 0;
+	}
 
-	if (buffer < end) {
-		value = (uint32_t)*buffer << 24;
-		++buffer;
-		if (buffer < end) {
-			value |= (uint32_t) *buffer << 16;
-			++buffer;
-			if (buffer < end) {
-				value |= (uint32_t) *buffer << 8;
-				++buffer;
-				if (buffer < end) {
-					value |= (uint32_t) *buffer;
-				}
-			}
-		}
+	value = 0;
+	for (i = 0; i < 8; i++) {
+		value <<= 8;
+		if (buffer + i < end)
+			value |= buffer[i];
 	}
 	return value;
+}
 
+// the next 57 or more bits of the stream at bitPos, left-justified
+static /*inline*/ uint64_t ALWAYS_INLINE peekstreambits( uint8_t * in, uint8_t * inEnd, uint32_t bitPos )
+{
+	return read64bit_ex( in + (bitPos >> 3), inEnd ) << (bitPos & 7);
 }
 
 #if PRAGMA_MARK
@@ -181,42 +184,6 @@ static /*inline*/ uint32_t ALWAYS_INLINE read32bit_ex( uint8_t * buffer, uint8_t
 #define get_next_fromlong(inlong, suff)		((inlong) >> (32 - (suff)))
 
 
-static /*inline*/ uint32_t ALWAYS_INLINE
-getstreambits( uint8_t *in, uint8_t * inEnd, int32_t bitoffset, int32_t numbits )
-{
-	uint32_t	load1, load2;
-	uint32_t	byteoffset = bitoffset / 8;
-	uint32_t	result;
-	
-	//Assert( numbits <= 32 );
-
-	load1 = read32bit_ex( in + byteoffset, inEnd );
-
-	if ( (numbits + (bitoffset & 0x7)) > 32)
-	{
-		int32_t load2shift;
-
-		result = load1 << (bitoffset & 0x7);
-		load2 = (uint32_t) in[byteoffset+4];
-		load2shift = (8-(numbits + (bitoffset & 0x7)-32));
-		load2 >>= load2shift;
-		result >>= (32-numbits);
-		result |= load2;		
-	}
-	else
-	{
-		result = load1 >> (32-numbits-(bitoffset & 7));
-	}
-
-	// a shift of >= "the number of bits in the type of the value being shifted" results in undefined
-	// behavior so don't try to shift by 32
-	if ( numbits != (sizeof(result) * 8) )
-		result &= ~(0xfffffffful << numbits);
-	
-	return result;
-}
-
-
 static /*inline*/ int32_t dyn_get(uint8_t *in, uint8_t * inEnd, uint32_t *bitPos, uint32_t m, uint32_t k)
 {
     uint32_t	tempbits = *bitPos;
@@ -224,14 +191,10 @@ static /*inline*/ int32_t dyn_get(uint8_t *in, uint8_t * inEnd, uint32_t *bitPos
     uint32_t		pre = 0, v;
     uint32_t		streamlong;
 
-	streamlong = read32bit_ex( in + (tempbits >> 3), inEnd );
-    streamlong <<= (tempbits & 7);
+	streamlong = (uint32_t)(peekstreambits( in, inEnd, tempbits ) >> 32);
 
-    /* find the number of bits in the prefix */ 
-    {
-        uint32_t	notI = ~streamlong;
-    	pre = lead( notI);
-    }
+    /* find the number of bits in the prefix, saturating instead of hitting lead(0) */
+    pre = lead( ~streamlong | 1 );
 
     if(pre >= MAX_PREFIX_16)
     {
@@ -270,21 +233,20 @@ static /*inline*/ int32_t dyn_get_32bit( uint8_t * in, uint8_t * inEnd, uint32_t
 {
 	uint32_t	tempbits = *bitPos;
 	uint32_t		v;
+	uint64_t		stream;
 	uint32_t		streamlong;
 	uint32_t		result;
 	
-	streamlong = read32bit_ex( in + (tempbits >> 3), inEnd );
-	streamlong <<= (tempbits & 7);
+	// one load covers the escape too: MAX_PREFIX_32 + maxbits <= 41 bits
+	stream = peekstreambits( in, inEnd, tempbits );
+	streamlong = (uint32_t)(stream >> 32);
 
-	/* find the number of bits in the prefix */ 
-	{
-		uint32_t notI = ~streamlong;
-		result = lead( notI);
-	}
+	/* find the number of bits in the prefix, saturating instead of hitting lead(0) */
+	result = lead( ~streamlong | 1 );
 	
 	if(result >= MAX_PREFIX_32)
 	{
-		result = getstreambits(in, inEnd, tempbits+MAX_PREFIX_32, maxbits);
+		result = (uint32_t)((stream << MAX_PREFIX_32) >> (64 - maxbits));
 		tempbits += MAX_PREFIX_32 + maxbits;
 	}
 	else
@@ -72,6 +72,11 @@ static int32_t lead(int32_t m) {
 	unsigned long index = 0; _BitScanReverse(&index, m);
 	return 31 - index;
 }
+#elif defined(__llvm__) || defined(__GNUC__)
+static inline int32_t lead(int32_t m) {
+	// lead(0) is used by the zero run coder after a maximal run
+	return m ? __builtin_clz(m) : 32;
+}
 #else
 // note: implementing this with some kind of "count leading zeros" assembly is a big performance win
 static /*inline*/ int32_t lead( int32_t m )
@@ -126,6 +131,71 @@ static /*inline*/ uint32_t ALWAYS_INLINE read32bit( uint8_t * buffer )
 #pragma mark -
 #endif
 
+/*
+	Big-endian bit writer with a 64-bit accumulator: whole 32-bit words are stored once
+	they are complete.  Only the bits actually coded are changed in the output buffer,
+	like dyn_jam_noDeref() did, so the bits before the start position are preserved.
+*/
+typedef struct AGBitWriter
+{
+	uint8_t *	out;
+	uint64_t	acc;
+	uint32_t	nacc;		// number of pending bits in the low end of acc, always < 32
+} AGBitWriter;
+
+static /*inline*/ void ALWAYS_INLINE agw_store32( uint8_t * out, uint32_t value )
+{
+	out[0] = (uint8_t)(value >> 24);
+	out[1] = (uint8_t)(value >> 16);
+	out[2] = (uint8_t)(value >>  8);
+	out[3] = (uint8_t)value;
+}
+
+static /*inline*/ void ALWAYS_INLINE agw_init( AGBitWriter * w, uint8_t * out, uint32_t bitIndex )
+{
+	w->out  = out;
+	w->nacc = bitIndex;
+	w->acc  = out[0] >> (8 - bitIndex);
+}
+
+// numBits must be in 1..32, and value must fit in numBits
+static /*inline*/ void ALWAYS_INLINE agw_put( AGBitWriter * w, uint32_t numBits, uint32_t value )
+{
+	w->acc   = (w->acc << numBits) | value;
+	w->nacc += numBits;
+	if ( w->nacc >= 32 )
+	{
+		w->nacc -= 32;
+		agw_store32( w->out, (uint32_t)(w->acc >> w->nacc) );
+		w->out += 4;
+	}
+}
+
+static void agw_flush( AGBitWriter * w )
+{
+	while ( w->nacc >= 8 )
+	{
+		w->nacc -= 8;
+		*w->out++ = (uint8_t)(w->acc >> w->nacc);
+	}
+	if ( w->nacc > 0 )
+	{
+		uint32_t	keep = 0xffu >> w->nacc;
+
+		w->out[0] = (uint8_t)((w->out[0] & keep) | ((uint32_t)(w->acc << (8 - w->nacc)) & ~keep));
+	}
+}
+
+// ceil(2^40 / ((1 << k) - 1)): n / m == (n * recip) >> 40 for the k <= 16 and n < MAX_PREFIX_32 * m that dyn_code_32bit() divides
+static const uint64_t sRecipM[17] =
+{
+	0,
+	0x10000000000ull, 0x5555555556ull, 0x2492492493ull, 0x1111111112ull,
+	0x842108422ull,   0x410410411ull,  0x204081021ull,  0x101010102ull,
+	0x80402011ull,    0x40100402ull,   0x20040081ull,   0x10010011ull,
+	0x8004003ull,     0x4001001ull,    0x2000401ull,    0x1000101ull
+};
+
 static /*inline*/ int32_t dyn_code(int32_t m, int32_t k, int32_t n, uint32_t *outNumBits)
 {
 	uint32_t 	div, mod, de;
@@ -169,7 +239,11 @@ static /*inline*/ int32_t dyn_code_32bit(int32_t maxbits, uint32_t m, uint32_t k
 	uint32_t	value;
 	int32_t			didOverflow = 0;
 
-	div = n/m;
+	// anything at or above MAX_PREFIX_32 * m is escaped, so only the small quotients are needed
+	if (k < sizeof(sRecipM) / sizeof(sRecipM[0]))
+		div = (n >= MAX_PREFIX_32 * m) ? MAX_PREFIX_32 : (uint32_t)((n * sRecipM[k]) >> 40);
+	else
+		div = n/m;
 
 	if (div < MAX_PREFIX_32)
 	{
@@ -198,69 +272,6 @@ codeasescape:
 }
 
 
-static /*inline*/ void ALWAYS_INLINE dyn_jam_noDeref(unsigned char *out, uint32_t bitPos, uint32_t numBits, uint32_t value)
-{
-	uint32_t	*i = (uint32_t *)(out + (bitPos >> 3));
-	uint32_t	mask;
-	uint32_t	curr;
-	uint32_t	shift;
-
-	//Assert( numBits <= 32 );
-
-	curr = *i;
-	curr = Swap32NtoB( curr );
-
-	shift = 32 - (bitPos & 7) - numBits;
-
-	mask = ~0u >> (32 - numBits);		// mask must be created in two steps to avoid compiler sequencing ambiguity
-	mask <<= shift;
-
-	value  = (value << shift) & mask;
-	value |= curr & ~mask;
-	
-	*i = Swap32BtoN( value );
-}
-
-
-static /*inline*/ void ALWAYS_INLINE dyn_jam_noDeref_large(unsigned char *out, uint32_t bitPos, uint32_t numBits, uint32_t value)
-{
-	uint32_t *	i = (uint32_t *)(out + (bitPos>>3));
-	uint32_t	w;
-	uint32_t	curr;
-	uint32_t	mask;
-	int32_t			shiftvalue = (32 - (bitPos&7) - numBits);
-	
-	//Assert(numBits <= 32);
-
-	curr = *i;
-	curr = Swap32NtoB( curr );
-
-	if (shiftvalue < 0)
-	{
-		uint8_t 	tailbyte;
-		uint8_t 	*tailptr;
-
-		w = value >> -shiftvalue;
-		mask = ~0u >> -shiftvalue;
-		w |= (curr & ~mask);
-
-		tailptr = ((uint8_t *)i) + 4;
-		tailbyte = (value << ((8+shiftvalue))) & 0xff;
-		*tailptr = (uint8_t)tailbyte;
-	}
-	else
-	{
-		mask = ~0u >> (32 - numBits);
-		mask <<= shiftvalue;			// mask must be created in two steps to avoid compiler sequencing ambiguity
-
-		w  = (value << shiftvalue) & mask;
-		w |= curr & ~mask;
-	}
-	
-	*i = Swap32BtoN( w );
-}
-
-
 int32_t dyn_comp( AGParamRecPtr params, int32_t * pc, BitBuffer * bitstream, int32_t numSamples, int32_t bitSize, uint32_t * outNumBits )
 {
     unsigned char *		out;
@@ -278,6 +289,7 @@ int32_t dyn_comp( AGParamRecPtr params, int32_t * pc, BitBuffer * bitstream, int
     int32_t					rowSize = params->sw;
     int32_t					rowJump = (params->fw) - rowSize;
     int32_t *			inPtr = pc;
+    AGBitWriter			writer;
 
 	*outNumBits = 0;
 	RequireAction( (bitSize >= 1) && (bitSize <= 32), return kALAC_ParamError; );
@@ -285,6 +297,7 @@ int32_t dyn_comp( AGParamRecPtr params, int32_t * pc, BitBuffer * bitstream, int
 	out = bitstream->cur;
 	startPos = bitstream->bitIndex;
     bitPos = startPos;
+	agw_init( &writer, out, startPos );
 
     mb = params->mb = params->mb0;
     pb = params->pb;
@@ -313,14 +326,14 @@ int32_t dyn_comp( AGParamRecPtr params, int32_t * pc, BitBuffer * bitstream, int
 
 		if ( dyn_code_32bit(bitSize, m, k, n, &numBits, &value, &overflow, &overflowbits) )
 		{
-			dyn_jam_noDeref(out, bitPos, numBits, value);
-			bitPos += numBits;			
-			dyn_jam_noDeref_large(out, bitPos, overflowbits, overflow);			
+			agw_put(&writer, numBits, value);
+			bitPos += numBits;
+			agw_put(&writer, overflowbits, overflow & (~0u >> (32 - overflowbits)));
 			bitPos += overflowbits;
 		}
 		else
 		{
-			dyn_jam_noDeref(out, bitPos, numBits, value);
+			agw_put(&writer, numBits, value);
 			bitPos += numBits;
 		}
       
@@ -369,16 +382,60 @@ int32_t dyn_comp( AGParamRecPtr params, int32_t * pc, BitBuffer * bitstream, int
             mz = ((1<<k)-1) & wb;
 
             value = dyn_code(mz, k, nz, &numBits);
-            dyn_jam_noDeref(out, bitPos, numBits, value);
+            agw_put(&writer, numBits, value);
             bitPos += numBits;
 
             mb = 0;
         }
     }
 
+	agw_flush( &writer );
+
     *outNumBits = (bitPos - startPos);
 	BitBufferAdvance( bitstream, *outNumBits );
 
 Exit:
 	return status;
 }
+
+/*
+	dyn_estimate()
+	- predicts what dyn_comp() would produce for pc[0..numSamples), in bits, without running the coder
+	- every run of 16 residuals is priced as a Rice code with the better of the two parameters around
+	  log2 of the run's mean, which follows the adaptive Golomb coder closely enough to rank candidates;
+	  runs of zeros cost next to nothing and codes are capped at the escape size
+*/
+uint32_t dyn_estimate( int32_t * pc, int32_t numSamples, int32_t bitSize )
+{
+	uint32_t	total = 0;
+	int32_t		c, j;
+
+	for ( c = 0; c < numSamples; c += 16 )
+	{
+		int32_t		len = arithmin( 16, numSamples - c );
+		uint64_t	sum = 0;
+		uint32_t	mean, k, cost0, cost1;
+		uint64_t	escape = (uint64_t) len * (MAX_PREFIX_32 + bitSize);
+
+		for ( j = 0; j < len; j++ )
+		{
+			int32_t		del = pc[c + j];
+
+			sum += (uint32_t)((abs_func( del ) << 1) - ((del >> 31) & 1));
+		}
+
+		if ( sum == 0 )
+		{
+			total += 1;
+			continue;
+		}
+
+		mean = (uint32_t) arithmin( sum / len, 0xffffffffu );
+		k = mean ? 31 - lead( mean ) : 0;
+		cost0 = (uint32_t) arithmin( len * (k + 1) + (sum >> k), escape );
+		cost1 = (uint32_t) arithmin( len * (k + 2) + (sum >> (k + 1)), escape );
+		total += arithmin( cost0, cost1 );
+	}
+
+	return total;
+}
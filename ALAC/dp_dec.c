@@ -30,6 +30,7 @@
 
 
 #include "dplib.h"
+#include "dp_simd.h"
 #include <string.h>
 #include <assert.h>
 
@@ -55,6 +56,99 @@ static /*inline*/ int32_t ALWAYS_INLINE sign_of_int( int32_t i )
     return negishift | (i >> 31);
 }
 
+#if ALAC_SIMD_X86
+
+// main loop of unpc_block() for numactive == 4 or 8, from j = numactive + 1 on
+// the last numactive outputs are kept in registers to avoid reloading what was just stored
+static ALAC_TARGET_SSE41 void unpc_block_sse41( const int32_t * pc1, int32_t * out, int32_t num, int16_t * coefs,
+												int32_t numactive, uint32_t chanshift, uint32_t denshift )
+{
+	const int32_t	nvec = numactive >> 2;
+	const int32_t	lim = numactive + 1;
+	const int32_t	denhalf = 1 << (denshift - 1);
+	__m128i			a[2], b[2], w[2], x[2];
+	int32_t			j, top, sum1, del;
+
+	if ( num <= lim )
+		return;
+
+	w[0] = _mm_setr_epi32( 1, 2, 3, 4 );
+	w[1] = _mm_setr_epi32( 5, 6, 7, 8 );
+	a[0] = dp_load_coefs_sse41( coefs + numactive - 4 );
+	a[1] = ( nvec > 1 ) ? dp_load_coefs_sse41( coefs ) : _mm_setzero_si128();
+	b[1] = _mm_setzero_si128();
+	x[0] = _mm_loadu_si128( (const __m128i *)(out + 1) );
+	x[1] = ( nvec > 1 ) ? _mm_loadu_si128( (const __m128i *)(out + 5) ) : _mm_setzero_si128();
+
+	for ( j = lim; j < num; j++ )
+	{
+		__m128i		vtop, prod, vout;
+
+		top = out[j - lim];
+		vtop = _mm_set1_epi32( top );
+		b[0] = _mm_sub_epi32( vtop, x[0] );
+		prod = _mm_mullo_epi32( a[0], b[0] );
+		if ( nvec > 1 )
+		{
+			b[1] = _mm_sub_epi32( vtop, x[1] );
+			prod = _mm_add_epi32( prod, _mm_mullo_epi32( a[1], b[1] ) );
+		}
+		sum1 = (denhalf - dp_hsum_sse41( prod )) >> denshift;
+
+		del = pc1[j];
+		out[j] = ((del + top + sum1) << chanshift) >> chanshift;
+		if ( del != 0 )
+			dp_adapt_sse41( a, b, w, nvec, del, denshift );
+
+		vout = _mm_cvtsi32_si128( out[j] );
+		if ( nvec > 1 )
+		{
+			x[0] = _mm_alignr_epi8( x[1], x[0], 4 );
+			x[1] = _mm_alignr_epi8( vout, x[1], 4 );
+		}
+		else
+			x[0] = _mm_alignr_epi8( vout, x[0], 4 );
+	}
+
+	dp_store_coefs_sse41( coefs + numactive - 4, a[0] );
+	if ( nvec > 1 )
+		dp_store_coefs_sse41( coefs, a[1] );
+}
+
+static ALAC_TARGET_AVX2 void unpc_block8_avx2( const int32_t * pc1, int32_t * out, int32_t num, int16_t * coefs,
+											   uint32_t chanshift, uint32_t denshift )
+{
+	const int32_t	lim = 9;
+	const int32_t	denhalf = 1 << (denshift - 1);
+	const __m256i	rotate = _mm256_setr_epi32( 1, 2, 3, 4, 5, 6, 7, 0 );
+	__m256i			a, b, x;
+	int32_t			j, top, sum1, del;
+
+	if ( num <= lim )
+		return;
+
+	a = dp_load_coefs8_avx2( coefs );
+	x = _mm256_loadu_si256( (const __m256i *)(out + 1) );
+
+	for ( j = lim; j < num; j++ )
+	{
+		top = out[j - lim];
+		b = _mm256_sub_epi32( _mm256_set1_epi32( top ), x );
+		sum1 = (denhalf - dp_hsum8_avx2( _mm256_mullo_epi32( a, b ) )) >> denshift;
+
+		del = pc1[j];
+		out[j] = ((del + top + sum1) << chanshift) >> chanshift;
+		if ( del != 0 )
+			a = dp_adapt8_avx2( a, b, del, denshift );
+
+		x = _mm256_blend_epi32( _mm256_permutevar8x32_epi32( x, rotate ), _mm256_set1_epi32( out[j] ), 0x80 );
+	}
+
+	dp_store_coefs8_avx2( coefs, a );
+}
+
+#endif
+
 void unpc_block( int32_t * pc1, int32_t * out, int32_t num, int16_t * coefs, int32_t numactive, uint32_t chanbits, uint32_t denshift )
 {
 	register int16_t	a0, a1, a2, a3;
@@ -110,6 +204,19 @@ void unpc_block( int32_t * pc1, int32_t * out, int32_t num, int16_t * coefs, int
 
 	lim = numactive + 1;
 
+#if ALAC_SIMD_X86
+	if ( numactive == 8 && (ALACGetCPUFeatures() & kALACCPUAVX2) )
+	{
+		unpc_block8_avx2( pc1, out, num, coefs, chanshift, denshift );
+		return;
+	}
+	if ( (numactive == 4 || numactive == 8) && (ALACGetCPUFeatures() & kALACCPUSSE41) )
+	{
+		unpc_block_sse41( pc1, out, num, coefs, numactive, chanshift, denshift );
+		return;
+	}
+#endif
+
 	if ( numactive == 4 )
 	{
 		// optimization for numactive == 4
@@ -0,0 +1,186 @@
+/*
+	File:		dp_simd.h
+
+	Contains:	SSE4.1/AVX2 helpers for unpc_block() with numactive == 4 and
+				numactive == 8.
+
+	The coefficients are held in 32-bit lanes in reverse order: lane l holds
+	coefs[numactive - 1 - l], so that it pairs with sample [j - numactive + l],
+	and the sign-sign adaptation (which walks from the oldest tap to the newest
+	one and stops once the residual changes sign) proceeds in lane order.  The
+	early exit is evaluated for all lanes at once from a prefix sum of the
+	per-tap corrections.  All arithmetic wraps like the scalar code, so the
+	results are bit-exact.
+*/
+
+#ifndef __DP_SIMD_H__
+#define __DP_SIMD_H__
+
+#include "ALACSIMD.h"
+
+#if ALAC_SIMD_X86
+
+#include <immintrin.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+static __inline int32_t dp_trailing_ones( uint32_t x )
+{
+	unsigned long	index;
+
+	_BitScanForward( &index, ~x );
+	return (int32_t) index;
+}
+#define DP_INLINE	static __forceinline
+#else
+static inline int32_t dp_trailing_ones( uint32_t x )
+{
+	return __builtin_ctz( ~x );
+}
+#define DP_INLINE	static inline __attribute__((always_inline))
+#endif
+
+// number of taps adapted: the first one always, then one more for each leading lane
+// after which the residual has not yet changed sign (cont has one bit per lane)
+DP_INLINE int32_t dp_num_adapted( uint32_t cont, int32_t numactive )
+{
+	return dp_trailing_ones( cont & ((1u << (numactive - 1)) - 1) ) + 1;
+}
+
+// ---------------------------------------------------------------------------
+// SSE4.1, 4 lanes per vector
+// ---------------------------------------------------------------------------
+
+DP_INLINE ALAC_TARGET_SSE41 __m128i dp_load_coefs_sse41( const int16_t * coefs )
+{
+	// coefs[3], coefs[2], coefs[1], coefs[0]
+	__m128i		c = _mm_loadl_epi64( (const __m128i *) coefs );
+
+	c = _mm_shufflelo_epi16( c, _MM_SHUFFLE(0, 1, 2, 3) );
+	return _mm_cvtepi16_epi32( c );
+}
+
+DP_INLINE ALAC_TARGET_SSE41 void dp_store_coefs_sse41( int16_t * coefs, __m128i a )
+{
+	__m128i		c = _mm_packs_epi32( a, a );	// lanes are kept within int16 range
+
+	c = _mm_shufflelo_epi16( c, _MM_SHUFFLE(0, 1, 2, 3) );
+	_mm_storel_epi64( (__m128i *) coefs, c );
+}
+
+DP_INLINE ALAC_TARGET_SSE41 int32_t dp_hsum_sse41( __m128i x )
+{
+	x = _mm_add_epi32( x, _mm_shuffle_epi32( x, _MM_SHUFFLE(1, 0, 3, 2) ) );
+	x = _mm_add_epi32( x, _mm_shuffle_epi32( x, _MM_SHUFFLE(2, 3, 0, 1) ) );
+	return _mm_cvtsi128_si32( x );
+}
+
+DP_INLINE ALAC_TARGET_SSE41 __m128i dp_prefix_sum_sse41( __m128i x )
+{
+	x = _mm_add_epi32( x, _mm_slli_si128( x, 4 ) );
+	return _mm_add_epi32( x, _mm_slli_si128( x, 8 ) );
+}
+
+// wraps 32-bit lanes to int16, as the scalar code keeps coefficients in int16_t
+DP_INLINE ALAC_TARGET_SSE41 __m128i dp_wrap16_sse41( __m128i a )
+{
+	return _mm_srai_epi32( _mm_slli_epi32( a, 16 ), 16 );
+}
+
+/*
+	Adapts nvec (1 or 2) vectors of coefficients a[] for residual del != 0, given
+	b[] = top - x[j - numactive + l].  Weights w[] are the lane numbers + 1.
+*/
+DP_INLINE ALAC_TARGET_SSE41 void dp_adapt_sse41( __m128i * a, const __m128i * b, const __m128i * w,
+												int32_t nvec, int32_t del, uint32_t denshift )
+{
+	const __m128i	sg = _mm_set1_epi32( del );
+	const __m128i	zero = _mm_setzero_si128();
+	const __m128i	shift = _mm_cvtsi32_si128( (int32_t) denshift );
+	__m128i			sgn[2], carry = zero;
+	uint32_t		cont = 0;
+	int32_t			v, n;
+
+	for ( v = 0; v < nvec; v++ )
+	{
+		// sgn = sign(del) * sign(b), and the correction w * ((sgn * b) >> denshift)
+		__m128i		t, d0, c;
+
+		sgn[v] = _mm_sign_epi32( _mm_sign_epi32( _mm_set1_epi32( 1 ), b[v] ), sg );
+		t = _mm_sra_epi32( _mm_sign_epi32( _mm_abs_epi32( b[v] ), sg ), shift );
+		t = _mm_mullo_epi32( t, w[v] );
+		t = _mm_add_epi32( dp_prefix_sum_sse41( t ), carry );
+		carry = _mm_shuffle_epi32( t, _MM_SHUFFLE(3, 3, 3, 3) );
+		d0 = _mm_sub_epi32( sg, t );
+		c = ( del > 0 ) ? _mm_cmpgt_epi32( d0, zero ) : _mm_cmplt_epi32( d0, zero );
+		cont |= (uint32_t) _mm_movemask_ps( _mm_castsi128_ps( c ) ) << (4 * v);
+	}
+	n = dp_num_adapted( cont, 4 * nvec );
+	for ( v = 0; v < nvec; v++ )
+	{
+		const __m128i	lane = _mm_setr_epi32( 4 * v, 4 * v + 1, 4 * v + 2, 4 * v + 3 );
+		__m128i			mask = _mm_cmpgt_epi32( _mm_set1_epi32( n ), lane );
+
+		a[v] = dp_wrap16_sse41( _mm_sub_epi32( a[v], _mm_and_si128( sgn[v], mask ) ) );
+	}
+}
+
+// ---------------------------------------------------------------------------
+// AVX2, numactive == 8 in one vector
+// ---------------------------------------------------------------------------
+
+DP_INLINE ALAC_TARGET_AVX2 __m256i dp_load_coefs8_avx2( const int16_t * coefs )
+{
+	__m128i		c = _mm_loadu_si128( (const __m128i *) coefs );
+
+	c = _mm_shuffle_epi8( c, _mm_setr_epi8( 14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1 ) );
+	return _mm256_cvtepi16_epi32( c );
+}
+
+DP_INLINE ALAC_TARGET_AVX2 void dp_store_coefs8_avx2( int16_t * coefs, __m256i a )
+{
+	__m128i		c = _mm_packs_epi32( _mm256_castsi256_si128( a ), _mm256_extracti128_si256( a, 1 ) );
+
+	c = _mm_shuffle_epi8( c, _mm_setr_epi8( 14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1 ) );
+	_mm_storeu_si128( (__m128i *) coefs, c );
+}
+
+DP_INLINE ALAC_TARGET_AVX2 int32_t dp_hsum8_avx2( __m256i x )
+{
+	__m128i		y = _mm_add_epi32( _mm256_castsi256_si128( x ), _mm256_extracti128_si256( x, 1 ) );
+
+	y = _mm_add_epi32( y, _mm_shuffle_epi32( y, _MM_SHUFFLE(1, 0, 3, 2) ) );
+	y = _mm_add_epi32( y, _mm_shuffle_epi32( y, _MM_SHUFFLE(2, 3, 0, 1) ) );
+	return _mm_cvtsi128_si32( y );
+}
+
+DP_INLINE ALAC_TARGET_AVX2 __m256i dp_adapt8_avx2( __m256i a, __m256i b, int32_t del, uint32_t denshift )
+{
+	const __m256i	sg = _mm256_set1_epi32( del );
+	const __m256i	zero = _mm256_setzero_si256();
+	const __m128i	shift = _mm_cvtsi32_si128( (int32_t) denshift );
+	const __m256i	lane = _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 );
+	__m256i			sgn, t, d0, c, mask;
+	int32_t			n;
+
+	sgn = _mm256_sign_epi32( _mm256_sign_epi32( _mm256_set1_epi32( 1 ), b ), sg );
+	t = _mm256_sra_epi32( _mm256_sign_epi32( _mm256_abs_epi32( b ), sg ), shift );
+	t = _mm256_mullo_epi32( t, _mm256_add_epi32( lane, _mm256_set1_epi32( 1 ) ) );
+
+	// prefix sum within each 128-bit half, then carry the lower half into the upper one
+	t = _mm256_add_epi32( t, _mm256_slli_si256( t, 4 ) );
+	t = _mm256_add_epi32( t, _mm256_slli_si256( t, 8 ) );
+	c = _mm256_shuffle_epi32( t, _MM_SHUFFLE(3, 3, 3, 3) );
+	t = _mm256_add_epi32( t, _mm256_permute2x128_si256( c, c, 0x08 ) );
+
+	d0 = _mm256_sub_epi32( sg, t );
+	c = ( del > 0 ) ? _mm256_cmpgt_epi32( d0, zero ) : _mm256_cmpgt_epi32( zero, d0 );
+	n = dp_num_adapted( (uint32_t) _mm256_movemask_ps( _mm256_castsi256_ps( c ) ), 8 );
+	mask = _mm256_cmpgt_epi32( _mm256_set1_epi32( n ), lane );
+	a = _mm256_sub_epi32( a, _mm256_and_si256( sgn, mask ) );
+	return _mm256_srai_epi32( _mm256_slli_epi32( a, 16 ), 16 );
+}
+
+#endif	/* ALAC_SIMD_X86 */
+
+#endif	/* __DP_SIMD_H__ */
@@ -28,6 +28,7 @@
 
 #include "matrixlib.h"
 #include "ALACAudioTypes.h"
+#include "ALACSIMD.h"
 
 // up to 24-bit "offset" macros for the individual bytes of a 20/24-bit word
 #if TARGET_RT_BIG_ENDIAN
@@ -40,6 +41,149 @@
 	#define HBYTE	2
 #endif
 
+#if ALAC_SIMD_X86 && !TARGET_RT_BIG_ENDIAN
+
+#include <immintrin.h>
+
+/*
+	SSE4.1 versions of the interleaved (stride == 2) unmixers and of the mono predictor copies.
+	Each kernel handles numSamples & ~3 frames; the caller finishes the rest with the scalar code.
+*/
+
+// unmixes 4 stereo frames into x0 = { l0, r0, l1, r1 } and x1 = { l2, r2, l3, r3 }
+static inline ALAC_TARGET_SSE41 void unmix4_sse41( const int32_t * u, const int32_t * v, const uint16_t * shiftUV,
+												   int32_t bytesShifted, int32_t mixbits, int32_t mixres, __m128i * x0, __m128i * x1 )
+{
+	__m128i		l = _mm_loadu_si128( (const __m128i *) u );
+	__m128i		r = _mm_loadu_si128( (const __m128i *) v );
+
+	if ( mixres != 0 )
+	{
+		__m128i		m = _mm_sra_epi32( _mm_mullo_epi32( r, _mm_set1_epi32( mixres ) ), _mm_cvtsi32_si128( mixbits ) );
+
+		l = _mm_sub_epi32( _mm_add_epi32( l, r ), m );
+		r = _mm_sub_epi32( l, r );
+	}
+
+	*x0 = _mm_unpacklo_epi32( l, r );
+	*x1 = _mm_unpackhi_epi32( l, r );
+
+	if ( bytesShifted != 0 )
+	{
+		__m128i		shift = _mm_cvtsi32_si128( bytesShifted * 8 );
+		__m128i		lo = _mm_loadu_si128( (const __m128i *) shiftUV );
+
+		*x0 = _mm_or_si128( _mm_sll_epi32( *x0, shift ), _mm_cvtepu16_epi32( lo ) );
+		*x1 = _mm_or_si128( _mm_sll_epi32( *x1, shift ), _mm_cvtepu16_epi32( _mm_srli_si128( lo, 8 ) ) );
+	}
+}
+
+// stores the low 24 bits of the 8 samples in x0 and x1 packed into 24 bytes
+static inline ALAC_TARGET_SSE41 void store24x8_sse41( uint8_t * op, __m128i x0, __m128i x1 )
+{
+	const __m128i	pick = _mm_setr_epi8( 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1 );
+
+	x0 = _mm_shuffle_epi8( x0, pick );
+	x1 = _mm_shuffle_epi8( x1, pick );
+	_mm_storeu_si128( (__m128i *) op, _mm_or_si128( x0, _mm_slli_si128( x1, 12 ) ) );
+	_mm_storel_epi64( (__m128i *)(op + 16), _mm_srli_si128( x1, 4 ) );
+}
+
+static ALAC_TARGET_SSE41 void unmix16_sse41( int32_t * u, int32_t * v, int16_t * out, int32_t numSamples, int32_t mixbits, int32_t mixres )
+{
+	const __m128i	pick = _mm_setr_epi8( 0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1 );
+	int32_t			j;
+
+	for ( j = 0; j < numSamples; j += 4 )
+	{
+		__m128i		x0, x1;
+
+		unmix4_sse41( u + j, v + j, 0, 0, mixbits, mixres, &x0, &x1 );
+		_mm_storeu_si128( (__m128i *)(out + j * 2),
+						  _mm_unpacklo_epi64( _mm_shuffle_epi8( x0, pick ), _mm_shuffle_epi8( x1, pick ) ) );
+	}
+}
+
+// 20-bit (alignShift == 4) or 24-bit (alignShift == 0) packed samples
+static ALAC_TARGET_SSE41 void unmix24_sse41( int32_t * u, int32_t * v, uint8_t * out, int32_t numSamples, int32_t mixbits, int32_t mixres,
+											 uint16_t * shiftUV, int32_t bytesShifted, int32_t alignShift )
+{
+	const __m128i	align = _mm_cvtsi32_si128( alignShift );
+	int32_t			j;
+
+	for ( j = 0; j < numSamples; j += 4 )
+	{
+		__m128i		x0, x1;
+
+		unmix4_sse41( u + j, v + j, shiftUV + j * 2, bytesShifted, mixbits, mixres, &x0, &x1 );
+		store24x8_sse41( out + j * 6, _mm_sll_epi32( x0, align ), _mm_sll_epi32( x1, align ) );
+	}
+}
+
+static ALAC_TARGET_SSE41 void unmix32_sse41( int32_t * u, int32_t * v, int32_t * out, int32_t numSamples, int32_t mixbits, int32_t mixres,
+											 uint16_t * shiftUV, int32_t bytesShifted )
+{
+	int32_t		j;
+
+	for ( j = 0; j < numSamples; j += 4 )
+	{
+		__m128i		x0, x1;
+
+		unmix4_sse41( u + j, v + j, shiftUV + j * 2, bytesShifted, mixbits, mixres, &x0, &x1 );
+		_mm_storeu_si128( (__m128i *)(out + j * 2), x0 );
+		_mm_storeu_si128( (__m128i *)(out + j * 2 + 4), x1 );
+	}
+}
+
+// mono 20-bit (alignShift == 4) or 24-bit (alignShift == 0) samples, 8 at a time, with optional shifted-off bytes
+static ALAC_TARGET_SSE41 void copyPredictorTo24_sse41( int32_t * in, uint16_t * shift, uint8_t * out, int32_t numSamples,
+													   int32_t bytesShifted, int32_t alignShift )
+{
+	const __m128i	align = _mm_cvtsi32_si128( alignShift );
+	const __m128i	shiftVal = _mm_cvtsi32_si128( bytesShifted * 8 );
+	int32_t			j;
+
+	for ( j = 0; j < numSamples; j += 8 )
+	{
+		__m128i		x0 = _mm_loadu_si128( (const __m128i *)(in + j) );
+		__m128i		x1 = _mm_loadu_si128( (const __m128i *)(in + j + 4) );
+
+		if ( bytesShifted != 0 )
+		{
+			__m128i		lo = _mm_loadu_si128( (const __m128i *)(shift + j) );
+
+			x0 = _mm_or_si128( _mm_sll_epi32( x0, shiftVal ), _mm_cvtepu16_epi32( lo ) );
+			x1 = _mm_or_si128( _mm_sll_epi32( x1, shiftVal ), _mm_cvtepu16_epi32( _mm_srli_si128( lo, 8 ) ) );
+		}
+		store24x8_sse41( out + j * 3, _mm_sll_epi32( x0, align ), _mm_sll_epi32( x1, align ) );
+	}
+}
+
+// any bit depth, MSB aligned in 32 bits (alignShift == 32 - bitDepth)
+static ALAC_TARGET_SSE41 void unmixAligned32_sse41( int32_t * u, int32_t * v, int32_t * out, int32_t numSamples, int32_t mixbits, int32_t mixres,
+													uint16_t * shiftUV, int32_t bytesShifted, int32_t alignShift )
+{
+	const __m128i	align = _mm_cvtsi32_si128( alignShift );
+	int32_t			j;
+
+	for ( j = 0; j < numSamples; j += 4 )
+	{
+		__m128i		x0, x1;
+
+		unmix4_sse41( u + j, v + j, shiftUV + j * 2, bytesShifted, mixbits, mixres, &x0, &x1 );
+		_mm_storeu_si128( (__m128i *)(out + j * 2), _mm_sll_epi32( x0, align ) );
+		_mm_storeu_si128( (__m128i *)(out + j * 2 + 4), _mm_sll_epi32( x1, align ) );
+	}
+}
+
+#define USE_SSE41( stride_, n_ )	( (stride_) == (n_) && (ALACGetCPUFeatures() & kALACCPUSSE41) )
+
+#else
+
+#define USE_SSE41( stride_, n_ )	0
+
+#endif
+
 /*
     There is no plain middle-side option; instead there are various mixing
     modes including middle-side, each lossless, as embodied in the mix()
@@ -62,6 +206,17 @@ void unmix16( int32_t * u, int32_t * v, int16_t * out, uint32_t stride, int32_t
 	int16_t *	op = out;
 	int32_t 		j;
 
+	if ( USE_SSE41( stride, 2 ) )
+	{
+		int32_t		n = numSamples & ~3;
+
+		unmix16_sse41( u, v, out, n, mixbits, mixres );
+		op += n * 2;
+		u += n;
+		v += n;
+		numSamples -= n;
+	}
+
 	if ( mixres != 0 )
 	{
 		/* matrixed stereo */
@@ -97,6 +252,17 @@ void unmix20( int32_t * u, int32_t * v, uint8_t * out, uint32_t stride, int32_t
 	uint8_t *	op = out;
 	int32_t 		j;
 
+	if ( USE_SSE41( stride, 2 ) )
+	{
+		int32_t		n = numSamples & ~3;
+
+		unmix24_sse41( u, v, out, n, mixbits, mixres, 0, 0, 4 );
+		op += n * 6;
+		u += n;
+		v += n;
+		numSamples -= n;
+	}
+
 	if ( mixres != 0 )
 	{
 		/* matrixed stereo */
@@ -156,6 +322,18 @@ void unmix24( int32_t * u, int32_t * v, uint8_t * out, uint32_t stride, int32_t
 	int32_t		l, r;
 	int32_t 		j, k;
 
+	if ( USE_SSE41( stride, 2 ) )
+	{
+		int32_t		n = numSamples & ~3;
+
+		unmix24_sse41( u, v, out, n, mixbits, mixres, shiftUV, bytesShifted, 0 );
+		op += n * 6;
+		u += n;
+		v += n;
+		shiftUV += n * 2;
+		numSamples -= n;
+	}
+
 	if ( mixres != 0 )
 	{
 		/* matrixed stereo */
@@ -262,6 +440,18 @@ void unmix32( int32_t * u, int32_t * v, int32_t * out, uint32_t stride, int32_t
 	int32_t		l, r;
 	int32_t 		j, k;
 
+	if ( USE_SSE41( stride, 2 ) )
+	{
+		int32_t		n = numSamples & ~3;
+
+		unmix32_sse41( u, v, out, n, mixbits, mixres, shiftUV, bytesShifted );
+		op += n * 2;
+		u += n;
+		v += n;
+		shiftUV += n * 2;
+		numSamples -= n;
+	}
+
 	if ( mixres != 0 )
 	{
 		//Assert( bytesShifted != 0 );
@@ -314,6 +504,16 @@ void copyPredictorTo24( int32_t * in, uint8_t * out, uint32_t stride, int32_t nu
 	uint8_t *	op = out;
 	int32_t			j;
 
+	if ( USE_SSE41( stride, 1 ) )
+	{
+		int32_t		n = numSamples & ~7;
+
+		copyPredictorTo24_sse41( in, 0, out, n, 0, 0 );
+		in += n;
+		op += n * 3;
+		numSamples -= n;
+	}
+
 	for ( j = 0; j < numSamples; j++ )
 	{
 		int32_t		val = in[j];
@@ -331,6 +531,17 @@ void copyPredictorTo24Shift( int32_t * in, uint16_t * shift, uint8_t * out, uint
 	int32_t			shiftVal = bytesShifted * 8;
 	int32_t			j;
 
+	if ( USE_SSE41( stride, 1 ) )
+	{
+		int32_t		n = numSamples & ~7;
+
+		copyPredictorTo24_sse41( in, shift, out, n, bytesShifted, 0 );
+		shift += n;
+		in += n;
+		op += n * 3;
+		numSamples -= n;
+	}
+
 	//Assert( bytesShifted != 0 );
 
 	for ( j = 0; j < numSamples; j++ )
@@ -351,6 +562,16 @@ void copyPredictorTo20( int32_t * in, uint8_t * out, uint32_t stride, int32_t nu
 	uint8_t *	op = out;
 	int32_t			j;
 
+	if ( USE_SSE41( stride, 1 ) )
+	{
+		int32_t		n = numSamples & ~7;
+
+		copyPredictorTo24_sse41( in, 0, out, n, 0, 4 );
+		in += n;
+		op += n * 3;
+		numSamples -= n;
+	}
+
 	// 32-bit predictor values are right-aligned but 20-bit output values should be left-aligned
 	// in the 24-bit output buffer
 	for ( j = 0; j < numSamples; j++ )
@@ -388,3 +609,65 @@ void copyPredictorTo32Shift( int32_t * in, uint16_t * shift, int32_t * out, uint
 		op += stride;
 	}
 }
+
+// 32-bit aligned output routines
+// - samples of any bit depth are written as 32-bit words with the valid bits at the top (alignShift == 32 - bitDepth)
+// - lets a client that wants 32-bit containers skip the packed 16/20/24-bit output and its conversion
+
+void unmixAligned32( int32_t * u, int32_t * v, int32_t * out, uint32_t stride, int32_t numSamples,
+						int32_t mixbits, int32_t mixres, uint16_t * shiftUV, int32_t bytesShifted, int32_t alignShift )
+{
+	int32_t *	op = out;
+	int32_t			shift = bytesShifted * 8;
+	int32_t		l, r;
+	int32_t 		j, k;
+
+	if ( USE_SSE41( stride, 2 ) )
+	{
+		int32_t		n = numSamples & ~3;
+
+		unmixAligned32_sse41( u, v, out, n, mixbits, mixres, shiftUV, bytesShifted, alignShift );
+		op += n * 2;
+		u += n;
+		v += n;
+		shiftUV += n * 2;
+		numSamples -= n;
+	}
+
+	for ( j = 0, k = 0; j < numSamples; j++, k += 2 )
+	{
+		l = u[j];
+		r = v[j];
+		if ( mixres != 0 )
+		{
+			l = u[j] + v[j] - ((mixres * v[j]) >> mixbits);
+			r = l - v[j];
+		}
+		if ( bytesShifted != 0 )
+		{
+			l = (int32_t)(((uint32_t) l << shift) | (uint32_t) shiftUV[k + 0]);
+			r = (int32_t)(((uint32_t) r << shift) | (uint32_t) shiftUV[k + 1]);
+		}
+		op[0] = (int32_t)((uint32_t) l << alignShift);
+		op[1] = (int32_t)((uint32_t) r << alignShift);
+		op += stride;
+	}
+}
+
+void copyPredictorToAligned32( int32_t * in, uint16_t * shift, int32_t * out, uint32_t stride, int32_t numSamples,
+								int32_t bytesShifted, int32_t alignShift )
+{
+	int32_t *		op = out;
+	uint32_t		shiftVal = bytesShifted * 8;
+	int32_t				j;
+
+	for ( j = 0; j < numSamples; j++ )
+	{
+		uint32_t	val = (uint32_t) in[j];
+
+		if ( bytesShifted != 0 )
+			val = (val << shiftVal) | (uint32_t) shift[j];
+		op[0] = (int32_t)(val << alignShift);
+		op += stride;
+	}
+}
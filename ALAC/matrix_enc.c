@@ -28,6 +28,7 @@
 
 #include "matrixlib.h"
 #include "ALACAudioTypes.h"
+#include "ALACSIMD.h"
 
 // up to 24-bit "offset" macros for the individual bytes of a 20/24-bit word
 #if TARGET_RT_BIG_ENDIAN
@@ -40,6 +41,124 @@
 	#define HBYTE	2
 #endif
 
+#if ALAC_SIMD_X86 && !TARGET_RT_BIG_ENDIAN
+
+#include <immintrin.h>
+
+/*
+	SSE4.1 versions of the interleaved (stride == 2) mixers and of the mono predictor copies.
+	Each kernel handles numSamples & ~3 frames; the caller finishes the rest with the scalar code.
+*/
+
+// mixes 4 stereo frames given as x0 = { l0, r0, l1, r1 } and x1 = { l2, r2, l3, r3 }
+static inline ALAC_TARGET_SSE41 void mix4_sse41( __m128i x0, __m128i x1, int32_t * u, int32_t * v,
+												 uint16_t * shiftUV, int32_t bytesShifted, int32_t mixbits, int32_t mixres )
+{
+	__m128i		l, r;
+
+	if ( bytesShifted != 0 )
+	{
+		__m128i		mask = _mm_set1_epi32( (1 << (bytesShifted * 8)) - 1 );
+		__m128i		shift = _mm_cvtsi32_si128( bytesShifted * 8 );
+
+		_mm_storeu_si128( (__m128i *) shiftUV, _mm_packus_epi32( _mm_and_si128( x0, mask ), _mm_and_si128( x1, mask ) ) );
+		x0 = _mm_sra_epi32( x0, shift );
+		x1 = _mm_sra_epi32( x1, shift );
+	}
+
+	l = _mm_castps_si128( _mm_shuffle_ps( _mm_castsi128_ps( x0 ), _mm_castsi128_ps( x1 ), _MM_SHUFFLE(2, 0, 2, 0) ) );
+	r = _mm_castps_si128( _mm_shuffle_ps( _mm_castsi128_ps( x0 ), _mm_castsi128_ps( x1 ), _MM_SHUFFLE(3, 1, 3, 1) ) );
+
+	if ( mixres != 0 )
+	{
+		__m128i		m = _mm_add_epi32( _mm_mullo_epi32( l, _mm_set1_epi32( mixres ) ),
+									   _mm_mullo_epi32( r, _mm_set1_epi32( (1 << mixbits) - mixres ) ) );
+
+		_mm_storeu_si128( (__m128i *) u, _mm_sra_epi32( m, _mm_cvtsi32_si128( mixbits ) ) );
+		_mm_storeu_si128( (__m128i *) v, _mm_sub_epi32( l, r ) );
+	}
+	else
+	{
+		_mm_storeu_si128( (__m128i *) u, l );
+		_mm_storeu_si128( (__m128i *) v, r );
+	}
+}
+
+// loads 8 packed 24-bit samples from 24 bytes, left-justified in 32-bit lanes
+static inline ALAC_TARGET_SSE41 void load24x8_sse41( const uint8_t * ip, __m128i * x0, __m128i * x1 )
+{
+	*x0 = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *) ip ),
+							_mm_setr_epi8( -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11 ) );
+	*x1 = _mm_shuffle_epi8( _mm_loadu_si128( (const __m128i *)(ip + 8) ),
+							_mm_setr_epi8( -1, 4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12, -1, 13, 14, 15 ) );
+}
+
+static ALAC_TARGET_SSE41 void mix16_sse41( int16_t * in, int32_t * u, int32_t * v, int32_t numSamples, int32_t mixbits, int32_t mixres )
+{
+	int32_t		j;
+
+	for ( j = 0; j < numSamples; j += 4 )
+	{
+		__m128i		x = _mm_loadu_si128( (const __m128i *)(in + j * 2) );
+
+		mix4_sse41( _mm_cvtepi16_epi32( x ), _mm_cvtepi16_epi32( _mm_srli_si128( x, 8 ) ),
+					u + j, v + j, 0, 0, mixbits, mixres );
+	}
+}
+
+// 20-bit (alignShift == 12) or 24-bit (alignShift == 8) packed samples
+static ALAC_TARGET_SSE41 void mix24_sse41( uint8_t * in, int32_t * u, int32_t * v, int32_t numSamples, int32_t mixbits, int32_t mixres,
+										   uint16_t * shiftUV, int32_t bytesShifted, int32_t alignShift )
+{
+	const __m128i	align = _mm_cvtsi32_si128( alignShift );
+	int32_t			j;
+
+	for ( j = 0; j < numSamples; j += 4 )
+	{
+		__m128i		x0, x1;
+
+		load24x8_sse41( in + j * 6, &x0, &x1 );
+		mix4_sse41( _mm_sra_epi32( x0, align ), _mm_sra_epi32( x1, align ),
+					u + j, v + j, shiftUV + j * 2, bytesShifted, mixbits, mixres );
+	}
+}
+
+static ALAC_TARGET_SSE41 void mix32_sse41( int32_t * in, int32_t * u, int32_t * v, int32_t numSamples, int32_t mixbits, int32_t mixres,
+										   uint16_t * shiftUV, int32_t bytesShifted )
+{
+	int32_t		j;
+
+	for ( j = 0; j < numSamples; j += 4 )
+	{
+		mix4_sse41( _mm_loadu_si128( (const __m128i *)(in + j * 2) ), _mm_loadu_si128( (const __m128i *)(in + j * 2 + 4) ),
+					u + j, v + j, shiftUV + j * 2, bytesShifted, mixbits, mixres );
+	}
+}
+
+// mono 20-bit (alignShift == 12) or 24-bit (alignShift == 8) samples, 8 at a time
+static ALAC_TARGET_SSE41 void copy24ToPredictor_sse41( uint8_t * in, int32_t * out, int32_t numSamples, int32_t alignShift )
+{
+	const __m128i	align = _mm_cvtsi32_si128( alignShift );
+	int32_t			j;
+
+	for ( j = 0; j < numSamples; j += 8 )
+	{
+		__m128i		x0, x1;
+
+		load24x8_sse41( in + j * 3, &x0, &x1 );
+		_mm_storeu_si128( (__m128i *)(out + j), _mm_sra_epi32( x0, align ) );
+		_mm_storeu_si128( (__m128i *)(out + j + 4), _mm_sra_epi32( x1, align ) );
+	}
+}
+
+#define USE_SSE41( stride_, n_ )	( (stride_) == (n_) && (ALACGetCPUFeatures() & kALACCPUSSE41) )
+
+#else
+
+#define USE_SSE41( stride_, n_ )	0
+
+#endif
+
 /*
     There is no plain middle-side option; instead there are various mixing
     modes including middle-side, each lossless, as embodied in the mix()
@@ -62,6 +181,17 @@ void mix16( int16_t * in, uint32_t stride, int32_t * u, int32_t * v, int32_t num
 	int16_t	*	ip = in;
 	int32_t			j;
 
+	if ( USE_SSE41( stride, 2 ) )
+	{
+		int32_t		n = numSamples & ~3;
+
+		mix16_sse41( in, u, v, n, mixbits, mixres );
+		ip += n * 2;
+		u += n;
+		v += n;
+		numSamples -= n;
+	}
+
 	if ( mixres != 0 )
 	{
 		int32_t		mod = 1 << mixbits;
@@ -101,6 +231,17 @@ void mix20( uint8_t * in, uint32_t stride, int32_t * u, int32_t * v, int32_t num
 	uint8_t *	ip = in;
 	int32_t			j;
 
+	if ( USE_SSE41( stride, 2 ) )
+	{
+		int32_t		n = numSamples & ~3;
+
+		mix24_sse41( in, u, v, n, mixbits, mixres, 0, 0, 12 );
+		ip += n * 6;
+		u += n;
+		v += n;
+		numSamples -= n;
+	}
+
 	if ( mixres != 0 )
 	{
 		/* matrixed stereo */
@@ -149,6 +290,18 @@ void mix24( uint8_t * in, uint32_t stride, int32_t * u, int32_t * v, int32_t num
 	uint32_t	mask  = (1ul << shift) - 1;
 	int32_t			j, k;
 
+	if ( USE_SSE41( stride, 2 ) )
+	{
+		int32_t		n = numSamples & ~3;
+
+		mix24_sse41( in, u, v, n, mixbits, mixres, shiftUV, bytesShifted, 8 );
+		ip += n * 6;
+		u += n;
+		v += n;
+		shiftUV += n * 2;
+		numSamples -= n;
+	}
+
 	if ( mixres != 0 )
 	{
 		/* matrixed stereo */
@@ -249,6 +402,18 @@ void mix32( int32_t * in, uint32_t stride, int32_t * u, int32_t * v, int32_t num
 	int32_t		l, r;
 	int32_t			j, k;
 
+	if ( USE_SSE41( stride, 2 ) )
+	{
+		int32_t		n = numSamples & ~3;
+
+		mix32_sse41( in, u, v, n, mixbits, mixres, shiftUV, bytesShifted );
+		ip += n * 2;
+		u += n;
+		v += n;
+		shiftUV += n * 2;
+		numSamples -= n;
+	}
+
 	if ( mixres != 0 )
 	{
 		int32_t		mod = 1 << mixbits;
@@ -315,6 +480,16 @@ void copy20ToPredictor( uint8_t * in, uint32_t stride, int32_t * out, int32_t nu
 	uint8_t *	ip = in;
 	int32_t			j;
 
+	if ( USE_SSE41( stride, 1 ) )
+	{
+		int32_t		n = numSamples & ~7;
+
+		copy24ToPredictor_sse41( in, out, n, 12 );
+		ip += n * 3;
+		out += n;
+		numSamples -= n;
+	}
+
 	for ( j = 0; j < numSamples; j++ )
 	{
 		int32_t			val;
@@ -331,6 +506,16 @@ void copy24ToPredictor( uint8_t * in, uint32_t stride, int32_t * out, int32_t nu
 	uint8_t *	ip = in;
 	int32_t			j;
 
+	if ( USE_SSE41( stride, 1 ) )
+	{
+		int32_t		n = numSamples & ~7;
+
+		copy24ToPredictor_sse41( in, out, n, 8 );
+		ip += n * 3;
+		out += n;
+		numSamples -= n;
+	}
+
 	for ( j = 0; j < numSamples; j++ )
 	{
 		int32_t			val;
@@ -73,6 +73,12 @@ void	copyPredictorTo20( int32_t * in, uint8_t * out, uint32_t stride, int32_t nu
 void	copyPredictorTo32( int32_t * in, int32_t * out, uint32_t stride, int32_t numSamples );
 void	copyPredictorTo32Shift( int32_t * in, uint16_t * shift, int32_t * out, uint32_t stride, int32_t numSamples, int32_t bytesShifted );
 
+// any bit depth -> 32-bit words with the valid bits at the top (alignShift == 32 - bitDepth)
+void	unmixAligned32( int32_t * u, int32_t * v, int32_t * out, uint32_t stride, int32_t numSamples,
+						int32_t mixbits, int32_t mixres, uint16_t * shiftUV, int32_t bytesShifted, int32_t alignShift );
+void	copyPredictorToAligned32( int32_t * in, uint16_t * shift, int32_t * out, uint32_t stride, int32_t numSamples,
+								  int32_t bytesShifted, int32_t alignShift );
+
 #ifdef __cplusplus
 }
 #endif
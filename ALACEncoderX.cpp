@@ -1,5 +1,7 @@
 #include "ALACEncoderX.h"
 #include "cautil.h"
+#include "logging.h"
+#include "strutil.h"
 
 namespace {
     AudioFormatDescription toFormatDescription(
@@ -19,8 +21,12 @@ namespace {
     }
 }
 
-ALACEncoderX::ALACEncoderX(const ca::AudioStreamBasicDescription &desc)
-    : m_encoder(new ALACEncoder()), m_iasbd(desc)
+ALACEncoderX::ALACEncoderX(const ca::AudioStreamBasicDescription &desc,
+                           uint32_t frames_per_packet)
+    : m_packed_input(false), m_iasbd(desc), m_level(LEVEL_DEFAULT),
+      m_quit(false), m_element_input(0), m_element_frames(0),
+      m_element_generation(0), m_element_pending(0), m_element_quit(false),
+      m_packets_verified(0), m_verify_busy(false), m_verify_quit(false)
 {
     m_iafd = toFormatDescription(desc);
     m_iafd.mBytesPerFrame =
@@ -45,41 +51,432 @@ ALACEncoderX::ALACEncoderX(const ca::AudioStreamBasicDescription &desc)
     }
     if (desc.mFormatFlags & kAudioFormatFlagIsBigEndian)
         throw std::runtime_error("ALAC: Big endian input is not supported");
+    if (frames_per_packet < MIN_FRAMES_PER_PACKET ||
+        frames_per_packet > MAX_FRAMES_PER_PACKET)
+        throw std::runtime_error("ALAC: Not supported frames per packet");
     m_oasbd.mChannelsPerFrame = desc.mChannelsPerFrame;
     m_oasbd.mSampleRate = desc.mSampleRate;
-    m_oasbd.mFramesPerPacket = kALACDefaultFramesPerPacket;
+    m_oasbd.mFramesPerPacket = frames_per_packet;
     m_oafd = toFormatDescription(m_oasbd);
-    CHECKCA(m_encoder->InitializeEncoder(m_oafd));
+    m_encoder = createEncoder();
 
     m_stat.setBasicDescription(m_oasbd);
-    uint32_t pullbytes = desc.mBytesPerFrame * kALACDefaultFramesPerPacket;
-    m_input_buffer.resize(pullbytes);
-    m_output_buffer.resize(pullbytes * 2);
+    m_input_buffer.resize(desc.mBytesPerFrame * frames_per_packet);
+    m_output_buffer.resize(m_encoder->GetMaxOutputBytes());
+}
+
+ALACEncoderX::~ALACEncoderX()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+        m_cond.notify_all();
+    }
+    for (size_t i = 0; i < m_workers.size(); ++i)
+        m_workers[i].join();
+    {
+        std::lock_guard<std::mutex> lock(m_element_mutex);
+        m_element_quit = true;
+        m_element_cond.notify_all();
+    }
+    for (size_t i = 0; i < m_element_workers.size(); ++i)
+        m_element_workers[i].join();
+    {
+        std::lock_guard<std::mutex> lock(m_verify_mutex);
+        m_verify_quit = true;
+        m_verify_cond.notify_all();
+    }
+    if (m_verify_thread.joinable())
+        m_verify_thread.join();
+}
+
+void ALACEncoderX::setLevel(int level)
+{
+    if (level < 0 || level > LEVEL_MAX)
+        throw std::runtime_error("ALAC: Invalid compression level");
+    m_level = level;
+    configureEncoder(m_encoder.get());
+}
+
+void ALACEncoderX::configureEncoder(ALACEncoder *encoder)
+{
+    encoder->SetFastMode(m_level == LEVEL_FAST);
+    encoder->SetEstimateMode(m_level == LEVEL_FAST_SEARCH);
+    encoder->SetSearchLevel(m_level);
+}
+
+std::shared_ptr<ALACEncoder> ALACEncoderX::createEncoder()
+{
+    std::shared_ptr<ALACEncoder> encoder = std::make_shared<ALACEncoder>();
+    encoder->SetFrameSize(m_oasbd.mFramesPerPacket);
+    configureEncoder(encoder.get());
+    CHECKCA(encoder->InitializeEncoder(m_oafd));
+    return encoder;
+}
+
+void ALACEncoderX::setNumThreads(unsigned n)
+{
+    if (m_workers.size())
+        throw std::logic_error("ALACEncoderX: threads are already running");
+    for (unsigned i = 0; i < n; ++i) {
+        std::shared_ptr<ALACEncoder> encoder = createEncoder();
+        m_workers.push_back(Log::start_thread(&ALACEncoderX::encodeSegments,
+                                              this, encoder));
+    }
+}
+
+void ALACEncoderX::setElementThreads(unsigned n)
+{
+    if (m_elements.size())
+        throw std::logic_error("ALACEncoderX: threads are already running");
+    uint32_t nchannels = m_oasbd.mChannelsPerFrame;
+    if (nchannels < 3 || n < 2)
+        return;
+    for (uint32_t ch = 0; ch < nchannels; ) {
+        Element e;
+        e.encoder = createEncoder();
+        e.channel_index = ch;
+        e.output.resize(e.encoder->GetMaxOutputBytes());
+        e.status = 0;
+        m_elements.push_back(e);
+        ch += ALACEncoder::GetElementChannels(nchannels, ch);
+    }
+    n = std::min(n, static_cast<unsigned>(m_elements.size()));
+    for (unsigned i = 1; i < n; ++i)
+        m_element_workers.push_back(
+            Log::start_thread(&ALACEncoderX::runElementWorker, this, i));
+}
+
+void ALACEncoderX::setVerify(bool verify)
+{
+    if (!verify || m_verify_decoder)
+        return;
+    std::vector<uint8_t> cookie = getMagicCookie();
+    m_verify_decoder = std::make_shared<ALACDecoder>();
+    CHECKCA(m_verify_decoder->Init(cookie.data(), cookie.size()));
+    m_verify_thread = Log::start_thread(&ALACEncoderX::runVerifier, this);
 }
 
 uint32_t ALACEncoderX::encodeChunk(uint32_t npackets)
 {
+    if (m_workers.size())
+        return encodeChunkParallel();
+
     unsigned n = 0;
     for (n = 0; n < npackets; ++n) {
-        size_t nsamples = readSamplesFull(src(), &m_input_buffer[0],
-                                          kALACDefaultFramesPerPacket);
-        if (nsamples == 0)
+        size_t nsamples = readPacket(&m_input_buffer[0]);
+        if (nsamples == 0) {
+            finishVerify();
             break;
-        size_t nbytes = nsamples * m_iasbd.mBytesPerFrame;
-        if (m_iafd.mBytesPerFrame < m_iasbd.mBytesPerFrame)
-            util::pack(&m_input_buffer[0], &nbytes,
-                       m_iasbd.mBytesPerFrame / m_iasbd.mChannelsPerFrame,
-                       m_iafd.mBytesPerFrame / m_iafd.mChannelsPerFrame);
-
-        int32_t xbytes = static_cast<int32_t>(nbytes);
-        m_encoder->Encode(m_iafd, m_oafd, &m_input_buffer[0],
-                          &m_output_buffer[0], &xbytes);
+        }
+        int32_t xbytes;
+        if (m_elements.size())
+            encodePacketElements(&m_input_buffer[0], nsamples,
+                                 &m_output_buffer[0], &xbytes);
+        else
+            encodePacket(m_encoder.get(), &m_input_buffer[0], nsamples,
+                         &m_output_buffer[0], &xbytes);
         m_sink->writeSamples(&m_output_buffer[0], xbytes, nsamples);
         m_stat.updateWritten(nsamples, xbytes);
+        verifyPacket(&m_input_buffer[0], nsamples, &m_output_buffer[0],
+                     xbytes);
     }
     return n;
 }
 
+/*
+ * A source that can hand out packed samples of the input depth saves
+ * widening them to 32 bits, only to narrow them back in packInput().
+ */
+void ALACEncoderX::setSource(const std::shared_ptr<ISource> &source)
+{
+    m_src = source;
+    IPackedSource *ps = dynamic_cast<IPackedSource*>(source.get());
+    m_packed_input =
+        ps && ps->hasPackedSamples() &&
+        source->getSampleFormat().mBitsPerChannel == m_iasbd.mBitsPerChannel;
+}
+
+size_t ALACEncoderX::readPacket(uint8_t *buffer)
+{
+    if (m_packed_input)
+        return readPackedFull(src(), buffer, m_oasbd.mFramesPerPacket);
+    return readSamplesFull(src(), buffer, m_oasbd.mFramesPerPacket);
+}
+
+void ALACEncoderX::packInput(uint8_t *input, size_t nsamples)
+{
+    size_t ibytes = nsamples * m_iasbd.mBytesPerFrame;
+    if (!m_packed_input && m_iafd.mBytesPerFrame < m_iasbd.mBytesPerFrame)
+        util::pack(input, &ibytes,
+                   m_iasbd.mBytesPerFrame / m_iasbd.mChannelsPerFrame,
+                   m_iafd.mBytesPerFrame / m_iafd.mChannelsPerFrame);
+}
+
+void ALACEncoderX::encodePacket(ALACEncoder *encoder, uint8_t *input,
+                                size_t nsamples, uint8_t *output,
+                                int32_t *nbytes)
+{
+    packInput(input, nsamples);
+    *nbytes = static_cast<int32_t>(nsamples * m_iafd.mBytesPerFrame);
+    encoder->Encode(m_iafd, m_oafd, input, output, nbytes);
+}
+
+/*
+ * Hands the elements of one packet to the element workers, and joins
+ * their output into one packet.
+ */
+void ALACEncoderX::encodePacketElements(uint8_t *input, size_t nsamples,
+                                        uint8_t *output, int32_t *nbytes)
+{
+    packInput(input, nsamples);
+    {
+        std::lock_guard<std::mutex> lock(m_element_mutex);
+        m_element_input = input;
+        m_element_frames = static_cast<uint32_t>(nsamples);
+        m_element_pending = m_element_workers.size();
+        ++m_element_generation;
+        m_element_cond.notify_all();
+    }
+    encodeElements(0);
+    {
+        std::unique_lock<std::mutex> lock(m_element_mutex);
+        while (m_element_pending)
+            m_element_done.wait(lock);
+    }
+    BitBuffer bits;
+    BitBufferInit(&bits, output, m_output_buffer.size());
+    for (size_t i = 0; i < m_elements.size(); ++i) {
+        CHECKCA(m_elements[i].status);
+        BitBufferAppend(&bits, &m_elements[i].bits);
+    }
+    CHECKCA(m_encoder->FinishFrame(&bits, nbytes));
+}
+
+/*
+ * Element workers take every (workers + 1)th element, starting from their
+ * own number; the calling thread is worker 0.
+ */
+void ALACEncoderX::encodeElements(unsigned worker)
+{
+    size_t step = m_element_workers.size() + 1;
+    for (size_t i = worker; i < m_elements.size(); i += step) {
+        Element &e = m_elements[i];
+        uint32_t nchannels;
+        BitBufferInit(&e.bits, e.output.data(), e.output.size());
+        e.status = e.encoder->EncodeElement(&e.bits, m_iafd, m_element_input,
+                                            e.channel_index,
+                                            m_element_frames, &nchannels);
+    }
+}
+
+void ALACEncoderX::runElementWorker(unsigned worker)
+{
+    uint64_t generation = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_element_mutex);
+            while (!m_element_quit && m_element_generation == generation)
+                m_element_cond.wait(lock);
+            if (m_element_quit)
+                break;
+            generation = m_element_generation;
+        }
+        encodeElements(worker);
+        std::lock_guard<std::mutex> lock(m_element_mutex);
+        if (--m_element_pending == 0)
+            m_element_done.notify_all();
+    }
+}
+
+/*
+ * Reads one segment and hands it to the workers, then writes out
+ * finished segments in order.
+ * Blocks while too many segments are in flight, and at the end of input
+ * until everything has been written.
+ */
+uint32_t ALACEncoderX::encodeChunkParallel()
+{
+    std::shared_ptr<Segment> segment = std::make_shared<Segment>();
+    size_t pullbytes = m_input_buffer.size();
+    uint32_t n;
+    for (n = 0; n < SEGMENT_PACKETS; ++n) {
+        size_t off = segment->input.size();
+        segment->input.resize(off + pullbytes);
+        size_t nsamples = readPacket(&segment->input[off]);
+        if (nsamples == 0)
+            break;
+        segment->frames.push_back(nsamples);
+    }
+    if (n) {
+        /* copied before a worker packs the input in place */
+        segment->warmup.swap(m_warmup);
+        segment->warmup_frames.swap(m_warmup_frames);
+        uint32_t first = n - std::min<uint32_t>(n, WARMUP_PACKETS);
+        m_warmup.assign(segment->input.begin() + first * pullbytes,
+                        segment->input.begin() + n * pullbytes);
+        m_warmup_frames.assign(segment->frames.begin() + first,
+                               segment->frames.end());
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (n) {
+        m_segments.push_back(segment);
+        m_queue.push_back(segment);
+        m_cond.notify_all();
+    }
+    for (;;) {
+        while (m_segments.size() && m_segments.front()->done) {
+            std::shared_ptr<Segment> s = m_segments.front();
+            m_segments.pop_front();
+            lock.unlock();
+            if (s->error)
+                std::rethrow_exception(s->error);
+            const uint8_t *p = s->output.data();
+            for (size_t i = 0; i < s->frames.size(); ++i) {
+                m_sink->writeSamples(p, s->packet_bytes[i], s->frames[i]);
+                m_stat.updateWritten(s->frames[i], s->packet_bytes[i]);
+                verifyPacket(&s->input[i * pullbytes], s->frames[i],
+                             p, s->packet_bytes[i]);
+                p += s->packet_bytes[i];
+            }
+            lock.lock();
+        }
+        if (m_segments.empty() ||
+            (n && m_segments.size() < 2 * m_workers.size()))
+            break;
+        m_cond.wait(lock);
+    }
+    if (n == 0) {
+        lock.unlock();
+        finishVerify();
+    }
+    return n;
+}
+
+void ALACEncoderX::encodeSegments(std::shared_ptr<ALACEncoder> encoder)
+{
+    std::vector<uint8_t> output(m_output_buffer.size());
+    for (;;) {
+        std::shared_ptr<Segment> segment;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_quit && m_queue.empty())
+                m_cond.wait(lock);
+            if (m_quit)
+                break;
+            segment = m_queue.front();
+            m_queue.pop_front();
+        }
+        try {
+            encoder->ResetState();
+            size_t pullbytes = m_input_buffer.size();
+            for (size_t i = 0; i < segment->warmup_frames.size(); ++i) {
+                int32_t xbytes;
+                encodePacket(encoder.get(), &segment->warmup[i * pullbytes],
+                             segment->warmup_frames[i], output.data(),
+                             &xbytes);
+            }
+            for (size_t i = 0; i < segment->frames.size(); ++i) {
+                int32_t xbytes;
+                encodePacket(encoder.get(), &segment->input[i * pullbytes],
+                             segment->frames[i], output.data(), &xbytes);
+                segment->output.insert(segment->output.end(),
+                                       output.data(), output.data() + xbytes);
+                segment->packet_bytes.push_back(xbytes);
+            }
+        } catch (...) {
+            segment->error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        segment->done = true;
+        m_cond.notify_all();
+    }
+}
+
+/*
+ * Queues a packet for the verifier. Blocks while the queue is full, and
+ * throws if an earlier packet has failed.
+ */
+void ALACEncoderX::verifyPacket(const uint8_t *input, uint32_t nsamples,
+                                const uint8_t *packet, uint32_t nbytes)
+{
+    if (!m_verify_decoder)
+        return;
+    std::shared_ptr<VerifyItem> item = std::make_shared<VerifyItem>();
+    item->input.assign(input, input + nsamples * m_iafd.mBytesPerFrame);
+    item->packet.assign(packet, packet + nbytes);
+    item->nsamples = nsamples;
+
+    std::unique_lock<std::mutex> lock(m_verify_mutex);
+    while (m_verify_error.empty() &&
+           m_verify_queue.size() >= VERIFY_QUEUE_MAX)
+        m_verify_cond.wait(lock);
+    if (!m_verify_error.empty())
+        throw std::runtime_error(m_verify_error);
+    m_verify_queue.push_back(item);
+    m_verify_cond.notify_all();
+}
+
+void ALACEncoderX::finishVerify()
+{
+    if (!m_verify_decoder)
+        return;
+    std::unique_lock<std::mutex> lock(m_verify_mutex);
+    while (m_verify_error.empty() &&
+           (m_verify_queue.size() || m_verify_busy))
+        m_verify_cond.wait(lock);
+    if (!m_verify_error.empty())
+        throw std::runtime_error(m_verify_error);
+}
+
+void ALACEncoderX::runVerifier()
+{
+    uint32_t nchannels = m_oasbd.mChannelsPerFrame;
+    std::vector<uint8_t> output(m_oasbd.mFramesPerPacket *
+                                m_iafd.mBytesPerFrame);
+    for (;;) {
+        std::shared_ptr<VerifyItem> item;
+        {
+            std::unique_lock<std::mutex> lock(m_verify_mutex);
+            while (!m_verify_quit && m_verify_queue.empty())
+                m_verify_cond.wait(lock);
+            if (m_verify_quit)
+                break;
+            item = m_verify_queue.front();
+            m_verify_queue.pop_front();
+            m_verify_busy = true;
+        }
+        BitBuffer bits;
+        BitBufferInit(&bits, item->packet.data(), item->packet.size());
+        uint32_t ncount = 0;
+        int32_t err = m_verify_decoder->Decode(&bits, output.data(),
+                                               item->nsamples, nchannels,
+                                               &ncount);
+        std::string error;
+        if (err)
+            error = strutil::format("ALAC verify: decode error %d at "
+                                    "packet %llu", err,
+                                    static_cast<unsigned long long>(
+                                        m_packets_verified + 1));
+        else if (ncount != item->nsamples ||
+                 std::memcmp(output.data(), item->input.data(),
+                             item->input.size()))
+            error = strutil::format("ALAC verify: decoded packet %llu "
+                                    "differs from the input",
+                                    static_cast<unsigned long long>(
+                                        m_packets_verified + 1));
+
+        std::lock_guard<std::mutex> lock(m_verify_mutex);
+        m_verify_busy = false;
+        if (error.size()) {
+            if (m_verify_error.empty())
+                m_verify_error = error;
+        } else
+            ++m_packets_verified;
+        m_verify_cond.notify_all();
+    }
+}
+
 std::vector<uint8_t> ALACEncoderX::getMagicCookie()
 {
     uint32_t size =
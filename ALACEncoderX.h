@@ -3,10 +3,52 @@
 
 #include "iencoder.h"
 #include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <ALACEncoder.h>
+#include <ALACBitUtilities.h>
+#include <ALACDecoder.h>
 
 class ALACEncoderX: public IEncoder, public IEncoderStat {
+    /*
+     * Unit of work for multi-threaded encoding.
+     * Each segment is encoded from the initial encoder state, after a
+     * warm-up encode of the last WARMUP_PACKETS packets of the previous
+     * segment (output discarded), so that the result doesn't depend on
+     * which thread encodes which segment.
+     */
+    struct Segment {
+        std::vector<uint8_t> warmup;
+        std::vector<uint32_t> warmup_frames;
+        std::vector<uint8_t> input;
+        std::vector<uint32_t> frames;
+        std::vector<uint8_t> output;
+        std::vector<uint32_t> packet_bytes;
+        std::exception_ptr error;
+        bool done;
+        Segment(): done(false) {}
+    };
+    enum { SEGMENT_PACKETS = 256, WARMUP_PACKETS = 8 };
+
+    /*
+     * One SCE/CPE element of a multichannel packet, for element-parallel
+     * encoding. An element is always encoded by its own encoder, so the
+     * predictor state carries over exactly as in the serial encoder.
+     */
+    struct Element {
+        std::shared_ptr<ALACEncoder> encoder;
+        uint32_t channel_index;
+        std::vector<uint8_t> output;
+        BitBuffer bits;
+        int32_t status;
+    };
+
     std::shared_ptr<ISource> m_src;
+    /* source gives samples in the encoder input layout, no packing needed */
+    bool m_packed_input;
     std::shared_ptr<ISink> m_sink;
     std::shared_ptr<ALACEncoder> m_encoder;
     std::vector<uint8_t> m_input_buffer;
@@ -16,12 +58,95 @@ class ALACEncoderX: public IEncoder, public IEncoderStat {
     ca::AudioStreamBasicDescription m_oasbd;
     AudioFormatDescription m_oafd;
     EncoderStat m_stat;
+    int m_level;
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::shared_ptr<Segment>> m_segments; /* in input order */
+    std::deque<std::shared_ptr<Segment>> m_queue;    /* not yet taken */
+    /* unpacked input of the last packets read, next segment's warm-up */
+    std::vector<uint8_t> m_warmup;
+    std::vector<uint32_t> m_warmup_frames;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_quit;
+
+    /*
+     * Packet waiting for verification: the encoder input (in the packed
+     * layout the encoder takes) and the encoded packet.
+     */
+    struct VerifyItem {
+        std::vector<uint8_t> input;
+        std::vector<uint8_t> packet;
+        uint32_t nsamples;
+    };
+    enum { VERIFY_QUEUE_MAX = 64 };
+
+    std::vector<Element> m_elements;
+    std::vector<std::thread> m_element_workers;
+    std::mutex m_element_mutex;
+    std::condition_variable m_element_cond;
+    std::condition_variable m_element_done;
+    uint8_t *m_element_input;
+    uint32_t m_element_frames;
+    uint64_t m_element_generation;
+    unsigned m_element_pending;
+    bool m_element_quit;
+
+    std::shared_ptr<ALACDecoder> m_verify_decoder;
+    std::thread m_verify_thread;
+    std::deque<std::shared_ptr<VerifyItem>> m_verify_queue;
+    std::mutex m_verify_mutex;
+    std::condition_variable m_verify_cond;
+    std::string m_verify_error;
+    std::atomic<uint64_t> m_packets_verified;
+    bool m_verify_busy;
+    bool m_verify_quit;
 public:
-    ALACEncoderX(const ca::AudioStreamBasicDescription &desc);
-    void setFastMode(bool fast) { m_encoder->SetFastMode(fast); }
+    enum { LEVEL_FAST, LEVEL_FAST_SEARCH, LEVEL_DEFAULT, LEVEL_MAX = 4 };
+    enum { MIN_FRAMES_PER_PACKET = 32, MAX_FRAMES_PER_PACKET = 65536 };
+
+    /*
+     * frames_per_packet is the ALAC frame length: smaller packets go out
+     * sooner, larger ones spend less on packet headers.
+     */
+    ALACEncoderX(const ca::AudioStreamBasicDescription &desc,
+                 uint32_t frames_per_packet = kALACDefaultFramesPerPacket);
+    ~ALACEncoderX();
+    /*
+     * Compression level, trading speed for size:
+     * 0: no parameter search (--fast)
+     * 1: search with estimated bit costs (--fast-search)
+     * 2: the reference encoder search (default)
+     * 3: also predictor orders up to 16, denshift and pbFactor
+     * 4: also finer stereo mixing and every even predictor order
+     */
+    void setLevel(int level);
+    int level() const { return m_level; }
+    /*
+     * Encode on n worker threads.
+     * Stream is split into segments of SEGMENT_PACKETS packets, each of
+     * which is encoded independently from the initial encoder state and
+     * a short warm-up. Therefore the result is not byte-identical to
+     * encoding without threads (also for n = 1), but is the same for any
+     * n > 0. Input shorter than one segment encodes as without threads.
+     */
+    void setNumThreads(unsigned n);
+    /*
+     * Encode the elements of multichannel packets on up to n threads
+     * (the calling thread included). Result is identical to serial
+     * encoding. Has no effect on mono/stereo input, or when n < 2.
+     */
+    void setElementThreads(unsigned n);
+    /*
+     * Decode every packet again on a side thread, and compare it with
+     * the input. encodeChunk() throws once a mismatch has been found,
+     * and at the end of input waits until every packet is verified.
+     */
+    void setVerify(bool verify);
+    uint64_t packetsVerified() const { return m_packets_verified.load(); }
     uint32_t encodeChunk(uint32_t npackets);
     std::vector<uint8_t> getMagicCookie();
-    void setSource(const std::shared_ptr<ISource> &source) { m_src = source; }
+    void setSource(const std::shared_ptr<ISource> &source);
     void setSink(const std::shared_ptr<ISink> &sink) { m_sink = sink; }
     ISource *src() { return m_src.get(); }
     const ca::AudioStreamBasicDescription &getInputDescription() const
@@ -39,6 +164,23 @@ public:
     double overallBitrate() const { return m_stat.overallBitrate(); }
 
     static bool isAvailableOutputChannelLayout(uint32_t channel_layout_tag);
+private:
+    size_t readPacket(uint8_t *buffer);
+    void packInput(uint8_t *input, size_t nsamples);
+    void encodePacket(ALACEncoder *encoder, uint8_t *input, size_t nsamples,
+                      uint8_t *output, int32_t *nbytes);
+    uint32_t encodeChunkParallel();
+    void encodeSegments(std::shared_ptr<ALACEncoder> encoder);
+    void encodePacketElements(uint8_t *input, size_t nsamples,
+                              uint8_t *output, int32_t *nbytes);
+    void encodeElements(unsigned worker);
+    void runElementWorker(unsigned worker);
+    void verifyPacket(const uint8_t *input, uint32_t nsamples,
+                      const uint8_t *packet, uint32_t nbytes);
+    void finishVerify();
+    void runVerifier();
+    void configureEncoder(ALACEncoder *encoder);
+    std::shared_ptr<ALACEncoder> createEncoder();
 };
 
 #endif
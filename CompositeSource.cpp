@@ -17,6 +17,23 @@ size_t CompositeSource::readSamples(void *buffer, size_t nsamples)
     }
 }
 
+size_t CompositeSource::readBlock(const void **data, size_t nsamples)
+{
+    if (m_cur_file == m_sources.size())
+        return 0;
+    size_t rc = readSamplesView(m_sources[m_cur_file].get(), &m_pivot,
+                                data, nsamples);
+    if (rc > 0) {
+        m_position += rc;
+        return rc;
+    } else {
+        ++m_cur_file;
+        if (m_cur_file < m_sources.size())
+            m_sources[m_cur_file]->seekTo(0);
+        return readBlock(data, nsamples);
+    }
+}
+
 void CompositeSource::seekTo(int64_t pos)
 {
     uint64_t acc = 0;
@@ -3,8 +3,8 @@
 
 #include "ISource.h"
 
-class CompositeSource: public ISeekableSource, public ITagParser,
-        public IChapterParser
+class CompositeSource: public ISeekableSource, public IBlockSource,
+        public ITagParser, public IChapterParser
 {
     typedef std::shared_ptr<ISeekableSource> source_t;
     uint32_t m_cur_file;
@@ -14,6 +14,7 @@ class CompositeSource: public ISeekableSource, public ITagParser,
     std::map<std::string, std::string> m_tags;
     std::vector<misc::chapter_t> m_chapters;
     ca::AudioStreamBasicDescription m_asbd;
+    std::vector<uint8_t> m_pivot;
 public:
     CompositeSource() : m_cur_file(0), m_position(0), m_length(0) {}
 
@@ -28,6 +29,7 @@ public:
     uint64_t length() const { return m_length; }
     int64_t getPosition() { return m_position; }
     size_t readSamples(void *buffer, size_t nsamples);
+    size_t readBlock(const void **data, size_t nsamples);
     void seekTo(int64_t pos);
 
     const std::map<std::string, std::string> &getTags() const
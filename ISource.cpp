@@ -3,6 +3,7 @@
 #include <atomic>
 #include "ISource.h"
 #include "cautil.h"
+#include "simdutil.h"
 
 namespace {
     union uif_t {
@@ -63,6 +64,34 @@ size_t readSamplesFull(ISource *src, void *buffer, size_t nsamples)
     return nsamples - rest;
 }
 
+size_t readPackedFull(ISource *src, void *buffer, size_t nsamples)
+{
+    IPackedSource *ps = dynamic_cast<IPackedSource*>(src);
+    const ca::AudioStreamBasicDescription &sf = src->getSampleFormat();
+    unsigned bpf = (sf.mBitsPerChannel + 7) / 8 * sf.mChannelsPerFrame;
+    uint8_t *bp = static_cast<uint8_t*>(buffer);
+    size_t n, rest = nsamples;
+    while (rest > 0 && (n = ps->readPacked(bp, rest)) > 0) {
+        rest -= n;
+        bp += n * bpf;
+    }
+    return nsamples - rest;
+}
+
+size_t readSamplesView(ISource *src, std::vector<uint8_t> *pivot,
+                       const void **data, size_t nsamples)
+{
+    IBlockSource *bs = dynamic_cast<IBlockSource*>(src);
+    if (bs)
+        return bs->readBlock(data, nsamples);
+
+    unsigned bpf = src->getSampleFormat().mBytesPerFrame;
+    if (pivot->size() < nsamples * bpf)
+        pivot->resize(nsamples * bpf);
+    *data = pivot->data();
+    return src->readSamples(pivot->data(), nsamples);
+}
+
 size_t readSamplesAsFloat(ISource *src, std::vector<uint8_t> *pivot,
                           std::vector<float> *floatBuffer, size_t nsamples)
 {
@@ -81,30 +110,51 @@ size_t readSamplesAsFloat(ISource *src, std::vector<uint8_t> *pivot,
     if ((sf.mFormatFlags & kAudioFormatFlagIsFloat) && bpc == 4)
         return src->readSamples(floatBuffer, nsamples);
 
-    if (pivot->size() < nsamples * sf.mBytesPerFrame)
-        pivot->resize(nsamples * sf.mBytesPerFrame);
-
-    void *bp = &(*pivot)[0];
+    const void *bp;
     float *fp = floatBuffer;
-    nsamples = src->readSamples(bp, nsamples);
+    nsamples = readSamplesView(src, pivot, &bp, nsamples);
     size_t blen = nsamples * sf.mBytesPerFrame;
 
     if (sf.mFormatFlags & kAudioFormatFlagIsFloat) {
         if (bpc == 8) {
-            double *src = static_cast<double *>(bp);
-            std::transform(src, src + (blen / 8), fp, quantize);
+            const double *src = static_cast<const double *>(bp);
+            size_t i = simdutil::double_to_float(src, fp, blen / 8);
+            std::transform(src + i, src + (blen / 8), fp + i, quantize);
         } else if (bpc == 2) {
-            uint16_t *src = static_cast<uint16_t *>(bp);
-            init_h2s_table();
-            for (size_t i = 0; i < blen / 2; ++i)
-                *fp++ = h2s_table[src[i]].f / 65536.0;
+            const uint16_t *src = static_cast<const uint16_t *>(bp);
+            size_t i = simdutil::half_to_float(src, fp, blen / 2, 1.0f / 65536);
+            if (i < blen / 2)
+                init_h2s_table();
+            for (; i < blen / 2; ++i)
+                fp[i] = h2s_table[src[i]].f / 65536.0;
         } else {
             throw std::runtime_error("readSamplesAsFloat(): BUG");
         }
     } else {
-        int *src = static_cast<int *>(bp);
-        for (size_t i = 0; i < blen / 4; ++i)
-            *fp++ = src[i] / 2147483648.0f;
+        const int32_t *src = static_cast<const int32_t *>(bp);
+        size_t i = simdutil::int32_to_float(src, fp, blen / 4,
+                                            1.0f / 2147483648.0f);
+        for (; i < blen / 4; ++i)
+            fp[i] = src[i] / 2147483648.0f;
+    }
+    return nsamples;
+}
+
+size_t readSamplesPlanar(ISource *src, std::vector<uint8_t> *pivot,
+                         std::vector<float> *floatBuffer,
+                         float * const *channels, size_t nsamples)
+{
+    IPlanarSource *ps = dynamic_cast<IPlanarSource*>(src);
+    if (ps)
+        return ps->readPlanar(channels, nsamples);
+
+    uint32_t nchannels = src->getSampleFormat().mChannelsPerFrame;
+    nsamples = readSamplesAsFloat(src, pivot, floatBuffer, nsamples);
+    const float *fp = floatBuffer->data();
+    for (uint32_t ch = 0; ch < nchannels; ++ch) {
+        float *dst = channels[ch];
+        for (size_t i = 0; i < nsamples; ++i)
+            dst[i] = fp[i * nchannels + ch];
     }
     return nsamples;
 }
@@ -127,20 +177,17 @@ size_t readSamplesAsFloat(ISource *src, std::vector<uint8_t> *pivot,
     if ((sf.mFormatFlags & kAudioFormatFlagIsFloat) && bpc == 8)
         return src->readSamples(doubleBuffer, nsamples);
 
-    if (pivot->size() < nsamples * sf.mBytesPerFrame)
-        pivot->resize(nsamples * sf.mBytesPerFrame);
-
-    void *bp = &(*pivot)[0];
+    const void *bp;
     double *fp = doubleBuffer;
-    nsamples = src->readSamples(bp, nsamples);
+    nsamples = readSamplesView(src, pivot, &bp, nsamples);
     size_t blen = nsamples * sf.mBytesPerFrame;
 
     if (sf.mFormatFlags & kAudioFormatFlagIsFloat) {
         if (bpc == 4) {
-            float *src = static_cast<float*>(bp);
+            const float *src = static_cast<const float*>(bp);
             std::copy(src, src + (blen / 4), fp);
         } else if (bpc == 2) {
-            uint16_t *src = static_cast<uint16_t *>(bp);
+            const uint16_t *src = static_cast<const uint16_t *>(bp);
             init_h2s_table();
             for (size_t i = 0; i < blen / 2; ++i) {
                 *fp++ = h2s_table[src[i]].f / 65536.0;
@@ -149,9 +196,11 @@ size_t readSamplesAsFloat(ISource *src, std::vector<uint8_t> *pivot,
             throw std::runtime_error("readSamplesAsFloat(): BUG");
         }
     } else {
-        int *src = static_cast<int *>(bp);
-        for (size_t i = 0; i < blen / 4; ++i)
-            *fp++ = src[i] / 2147483648.0;
+        const int32_t *src = static_cast<const int32_t *>(bp);
+        size_t i = simdutil::int32_to_double(src, fp, blen / 4,
+                                             1.0 / 2147483648.0);
+        for (; i < blen / 4; ++i)
+            fp[i] = src[i] / 2147483648.0;
     }
     return nsamples;
 }
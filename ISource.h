@@ -20,6 +20,39 @@ struct ISeekableSource: public ISource {
     virtual void seekTo(int64_t offset) = 0;
 };
 
+/*
+ * Optional interface for sources holding samples in their own buffer.
+ * readBlock() works like readSamples(), but instead of copying, returns in
+ * *data a read-only view of the samples in the buffer of the source.
+ * The view is valid until the next call to the source.
+ */
+struct IBlockSource {
+    virtual ~IBlockSource() {}
+    virtual size_t readBlock(const void **data, size_t nsamples) = 0;
+};
+
+/*
+ * Integer sources that can hand out samples packed to their valid width
+ * (mBitsPerChannel rounded up to whole bytes, left-aligned, little endian)
+ * instead of widened to the 32-bit containers of getSampleFormat().
+ * readPacked() works like readSamples() otherwise. Only to be used when
+ * hasPackedSamples() is true, and not to be mixed with readSamples().
+ */
+struct IPackedSource {
+    virtual ~IPackedSource() {}
+    virtual bool hasPackedSamples() const = 0;
+    virtual size_t readPacked(void *buffer, size_t nsamples) = 0;
+};
+
+/*
+ * Float32 sources that can hand out channel-major samples.
+ * readPlanar() writes channel n to channels[n].
+ */
+struct IPlanarSource {
+    virtual ~IPlanarSource() {}
+    virtual size_t readPlanar(float * const *channels, size_t nsamples) = 0;
+};
+
 struct ITagParser {
     virtual ~ITagParser() {}
     virtual const std::map<std::string, std::string> &getTags() const = 0;
@@ -32,9 +65,27 @@ struct IChapterParser {
 
 size_t readSamplesFull(ISource *src, void *buffer, size_t nsamples);
 
+/*
+ * Same as readSamplesFull(), through IPackedSource::readPacked().
+ */
+size_t readPackedFull(ISource *src, void *buffer, size_t nsamples);
+
+/*
+ * Borrow samples from IBlockSource, or read into pivot otherwise.
+ */
+size_t readSamplesView(ISource *src, std::vector<uint8_t> *pivot,
+                       const void **data, size_t nsamples);
+
 size_t readSamplesAsFloat(ISource *src, std::vector<uint8_t> *pivot,
                           std::vector<float> *floatBuffer, size_t nsamples);
 
+/*
+ * Read from IPlanarSource directly, or deinterleave through floatBuffer.
+ */
+size_t readSamplesPlanar(ISource *src, std::vector<uint8_t> *pivot,
+                         std::vector<float> *floatBuffer,
+                         float * const *channels, size_t nsamples);
+
 size_t readSamplesAsFloat(ISource *src, std::vector<uint8_t> *pivot,
                           float *floatBuffer, size_t nsamples);
 
@@ -3,11 +3,14 @@
 
 #include "ISource.h"
 
-class TrimmedSource: public ISeekableSource, public ITagParser {
+class TrimmedSource: public ISeekableSource, public IBlockSource,
+    public IPackedSource, public ITagParser
+{
     uint64_t m_start;
     uint64_t m_duration;
     int64_t m_position;
     std::shared_ptr<ISeekableSource> m_src;
+    std::vector<uint8_t> m_pivot;
     std::map<std::string, std::string> m_emptyTags;
 public:
     TrimmedSource(const std::shared_ptr<ISeekableSource> &src)
@@ -22,6 +25,11 @@ public:
         setRange(start, duration);
     }
 
+    const std::shared_ptr<ISeekableSource> &getSource() const
+    {
+        return m_src;
+    }
+    uint64_t getStart() const { return m_start; }
     uint64_t length() const { return m_duration; }
     const ca::AudioStreamBasicDescription &getSampleFormat() const
     {
@@ -45,6 +53,32 @@ public:
         }
         return nsamples;
     }
+    size_t readBlock(const void **data, size_t nsamples)
+    {
+        nsamples = std::min(static_cast<uint64_t>(nsamples),
+                            m_duration - m_position);
+        if (nsamples) {
+            nsamples = readSamplesView(m_src.get(), &m_pivot, data, nsamples);
+            m_position += nsamples;
+        }
+        return nsamples;
+    }
+    bool hasPackedSamples() const
+    {
+        IPackedSource *ps = dynamic_cast<IPackedSource*>(m_src.get());
+        return ps && ps->hasPackedSamples();
+    }
+    size_t readPacked(void *buffer, size_t nsamples)
+    {
+        nsamples = std::min(static_cast<uint64_t>(nsamples),
+                            m_duration - m_position);
+        if (nsamples) {
+            IPackedSource *ps = dynamic_cast<IPackedSource*>(m_src.get());
+            nsamples = ps->readPacked(buffer, nsamples);
+            m_position += nsamples;
+        }
+        return nsamples;
+    }
 
     void seekTo(int64_t count)
     {
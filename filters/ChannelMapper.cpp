@@ -47,6 +47,20 @@ ChannelMapper::ChannelMapper(const std::shared_ptr<ISource> &source,
     }
 }
 
+bool ChannelMapper::hasPackedSamples() const
+{
+    /* only an identity mapping can pass packed samples through */
+    IPackedSource *ps = dynamic_cast<IPackedSource*>(sourcePtr().get());
+    return m_process == &ChannelMapper::processNothing
+        && ps && ps->hasPackedSamples();
+}
+
+size_t ChannelMapper::readPacked(void *buffer, size_t nsamples)
+{
+    return dynamic_cast<IPackedSource*>(source())->readPacked(buffer,
+                                                              nsamples);
+}
+
 size_t ChannelMapper::processNothing(void *buffer, size_t nsamples)
 {
     return source()->readSamples(buffer, nsamples);
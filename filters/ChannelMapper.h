@@ -3,7 +3,7 @@
 
 #include "FilterBase.h"
 
-class ChannelMapper: public FilterBase {
+class ChannelMapper: public FilterBase, public IPackedSource {
     std::vector<uint32_t> m_chanmap;
     std::vector<uint32_t> m_layout;
     size_t (ChannelMapper::*m_process)(void *, size_t);
@@ -19,6 +19,8 @@ public:
     {
         return (this->*m_process)(buffer, nsamples);
     }
+    bool hasPackedSamples() const;
+    size_t readPacked(void *buffer, size_t nsamples);
 private:
     size_t processNothing(void *buffer, size_t nsamples);
     template <typename T>
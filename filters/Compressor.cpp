@@ -2,6 +2,7 @@
 #include "Compressor.h"
 #include "cautil.h"
 #include "ascutil.h"
+#include "simdutil.h"
 
 namespace {
     template <typename T>
@@ -45,6 +46,14 @@ Compressor::Compressor(const std::shared_ptr<ISource> &src,
 }
 
 size_t Compressor::readSamples(void *buffer, size_t nsamples)
+{
+    const void *data;
+    nsamples = readBlock(&data, nsamples);
+    memcpy(buffer, data, nsamples * m_asbd.mBytesPerFrame);
+    return nsamples;
+}
+
+size_t Compressor::readBlock(const void **view, size_t nsamples)
 {
     const double Fs = m_asbd.mSampleRate;
     unsigned nchannels = m_asbd.mChannelsPerFrame;
@@ -74,17 +83,31 @@ size_t Compressor::readSamples(void *buffer, size_t nsamples)
     if (m_statbuf.size() < nsamples)
         m_statbuf.resize(nsamples);
 
+    /*
+     * Levels and gains are kept in log2 units in the float buffers, so
+     * that the log and exp run over whole blocks. Only the gain computer
+     * and the smoothing, which is recursive, go sample by sample.
+     */
+    const double dB_per_log2 = 20.0 * std::log10(2.0);
+    if (nsamples) {
+        computePeaks(data, nsamples, nchannels, lookahead);
+        simdutil::fast_log2(m_levels.data(), m_levels.data(), nsamples);
+    }
+    const float *level = m_levels.data();
+    float *gain = m_statbuf.data();
     for (size_t i = 0; i < nsamples; ++i) {
-        float xL = getPeakValue(data, i, nchannels, lookahead);
-        double xG = util::scale_to_dB(xL);
+        double xG = level[i] * dB_per_log2;
         double yG = computeGain(xG);
         double cG = smoothAverage(yG, alphaA, alphaR);
-        float cL = static_cast<float>(util::dB_to_scale(cG));
-        for (unsigned n = 0; n < nchannels; ++n)
-            data[i * nchannels + n] *= cL;
-        m_statbuf[i] = cL;
+        gain[i] = static_cast<float>(cG / dB_per_log2);
     }
-    memcpy(buffer, data, nsamples * bpf);
+    simdutil::fast_exp2(gain, gain, nsamples);
+    size_t i = simdutil::scale_frames(data, gain, nsamples, nchannels);
+    for (; i < nsamples; ++i)
+        for (unsigned n = 0; n < nchannels; ++n)
+            data[i * nchannels + n] *= gain[i];
+
+    *view = data;
     if (m_statsink.get()) {
         m_statsink->writeSamples(m_statbuf.data(), nsamples * sizeof(float),
                                  nsamples);
@@ -95,25 +118,43 @@ size_t Compressor::readSamples(void *buffer, size_t nsamples)
     return nsamples;
 }
 
-float Compressor::getPeakValue(const float *data, unsigned i,
-                               unsigned nchannels, unsigned lookahead)
+/*
+ * Peak of the frames within lookahead ahead of each frame, a sliding
+ * maximum over the frame amplitudes. Result goes to m_levels[0, nsamples).
+ */
+void Compressor::computePeaks(const float *data, size_t nsamples,
+                              unsigned nchannels, unsigned lookahead)
 {
+    size_t first = m_window.empty() ? 0 : lookahead;
+    size_t end = nsamples + lookahead;
+    if (m_levels.size() < end)
+        m_levels.resize(end);
+    float *level = m_levels.data();
+
+    size_t i = first + simdutil::frame_peak(&data[first * nchannels],
+                                            &level[first], end - first,
+                                            nchannels);
+    for (; i < end; ++i)
+        level[i] = frame_amplitude(&data[i * nchannels], nchannels);
     if (!lookahead)
-        return frame_amplitude(&data[i * nchannels], nchannels);
+        return;
+
     if (m_window.empty()) {
         for (unsigned k = 0; k < lookahead; ++k) {
-            float x = frame_amplitude(&data[k * nchannels], nchannels);
+            float x = level[k];
             while (!m_window.empty() && x >= m_window.back().second)
                 m_window.pop_back();
             m_window.push_back(std::make_pair((int64_t)k, x));
         }
     }
-    float res = m_window.front().second;
-    while (!m_window.empty() && m_window.front().first <= m_position + i)
-        m_window.pop_front();
-    float x = frame_amplitude(&data[(i + lookahead) * nchannels], nchannels);
-    while (!m_window.empty() && x >= m_window.back().second)
-        m_window.pop_back();
-    m_window.push_back(std::make_pair(m_position + i + lookahead, x));
-    return res;
+    for (i = 0; i < nsamples; ++i) {
+        float res = m_window.front().second;
+        while (!m_window.empty() && m_window.front().first <= m_position + (int64_t)i)
+            m_window.pop_front();
+        float x = level[i + lookahead];
+        while (!m_window.empty() && x >= m_window.back().second)
+            m_window.pop_back();
+        m_window.push_back(std::make_pair(m_position + i + lookahead, x));
+        level[i] = res;
+    }
 }
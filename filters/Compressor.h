@@ -6,7 +6,7 @@
 #include "util.h"
 #include "WaveSink.h"
 
-class Compressor: public FilterBase {
+class Compressor: public FilterBase, public IBlockSource {
     const double m_threshold;
     const double m_slope;
     const double m_attack;
@@ -26,6 +26,7 @@ class Compressor: public FilterBase {
     ca::AudioStreamBasicDescription m_asbd;
     std::shared_ptr<FILE> m_statfile;
     std::shared_ptr<WaveSink> m_statsink;
+    std::vector<float> m_levels;
     std::vector<float> m_statbuf;
 public:
     Compressor(const std::shared_ptr<ISource> &src,
@@ -37,9 +38,10 @@ public:
         return m_asbd;
     }
     size_t readSamples(void *buffer, size_t nsamples);
+    size_t readBlock(const void **data, size_t nsamples);
 private:
-    float getPeakValue(const float *data, unsigned i, unsigned nchannels,
-                       unsigned lookahead);
+    void computePeaks(const float *data, size_t nsamples,
+                      unsigned nchannels, unsigned lookahead);
     /*
      * gain computer, works on log domain
      */
@@ -12,9 +12,16 @@ void SoftClipper::process(const float *in, size_t nin, float *out, size_t *nout)
     for (int n = 0; n < m_nchannels; ++n) {
         std::vector<float> &x = m_buffer[n];
         x.reserve(x.size() + nin);
-        for (size_t i = 0; i < nin; ++i)
-            x.push_back(clip(in[i * m_nchannels + n],
-                             -3.0f * m_thresh, 3.0f * m_thresh));
+        if (m_gain == 1.0) {
+            for (size_t i = 0; i < nin; ++i)
+                x.push_back(clip(in[i * m_nchannels + n],
+                                 -3.0f * m_thresh, 3.0f * m_thresh));
+        } else {
+            for (size_t i = 0; i < nin; ++i) {
+                float value = in[i * m_nchannels + n] * m_gain;
+                x.push_back(clip(value, -3.0f * m_thresh, 3.0f * m_thresh));
+            }
+        }
 
         ssize_t limit = x.size();
         if (limit > 0 && nin > 0) {
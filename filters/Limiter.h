@@ -7,11 +7,13 @@
 class SoftClipper {
     int m_nchannels;
     float m_thresh;
+    double m_gain;
     std::vector<std::vector<float> > m_buffer;
     std::vector<size_t> m_processed;
 public:
-    explicit SoftClipper(int nchannels, float threshold=0.9921875f)
-        : m_nchannels(nchannels), m_thresh(threshold)
+    explicit SoftClipper(int nchannels, double gain=1.0,
+                         float threshold=0.9921875f)
+        : m_nchannels(nchannels), m_thresh(threshold), m_gain(gain)
     {
         m_buffer.resize(nchannels);
         m_processed.resize(nchannels);
@@ -25,9 +27,12 @@ class Limiter: public FilterBase {
     std::vector<float>   m_fbuffer;
     ca::AudioStreamBasicDescription m_asbd;
 public:
-    Limiter(const std::shared_ptr<ISource> &source)
+    /*
+     * scale is a gain applied in the same pass (instead of a Scaler).
+     */
+    Limiter(const std::shared_ptr<ISource> &source, double scale=1.0)
         : FilterBase(source),
-          m_clipper(source->getSampleFormat().mChannelsPerFrame)
+          m_clipper(source->getSampleFormat().mChannelsPerFrame, scale)
     {
         const ca::AudioStreamBasicDescription &asbd = source->getSampleFormat();
         m_asbd = ascutil::buildASBDForPCM(asbd.mSampleRate,
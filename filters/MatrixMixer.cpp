@@ -92,13 +92,13 @@ MatrixMixer::MatrixMixer(const std::shared_ptr<ISource> &source,
         normalizeMatrix(m_matrix);
     m_asbd = ascutil::buildASBDForPCM(fmt.mSampleRate, spec.size(),
                                      32, kAudioFormatFlagIsFloat);
-    m_buffer.set_unit(fmt.mChannelsPerFrame);
     for (unsigned i = 0; i < fmt.mChannelsPerFrame; ++i) {
         if (shiftMask & (1 << i))
             m_shift_channels.push_back(i);
         else
             m_pass_channels.push_back(i);
     }
+    m_syncque.resize(m_pass_channels.size());
     if (shiftMask)
         initFilter();
 }
@@ -122,78 +122,73 @@ void MatrixMixer::initFilter()
 }
 
 size_t MatrixMixer::readSamples(void *buffer, size_t nsamples)
+{
+    m_output.resize(m_asbd.mChannelsPerFrame, nsamples);
+    nsamples = readPlanar(m_output.pointers(), nsamples);
+    m_output.interleave(static_cast<float *>(buffer), nsamples);
+    return nsamples;
+}
+
+size_t MatrixMixer::readPlanar(float * const *channels, size_t nsamples)
 {
     uint32_t ichannels = source()->getSampleFormat().mChannelsPerFrame;
-    if (m_fbuffer.size() < nsamples * ichannels)
-        m_fbuffer.resize(nsamples * ichannels);
+    m_input.resize(ichannels, nsamples);
 
     if (m_shift_channels.size())
         nsamples = phaseShift(nsamples);
     else
-        nsamples = readSamplesAsFloat(source(), &m_ibuffer,
-                                      &m_fbuffer[0], nsamples);
+        nsamples = readSamplesPlanar(source(), &m_ibuffer, &m_fbuffer,
+                                     m_input.pointers(), nsamples);
 
-    float *op = static_cast<float*>(buffer);
-    for (size_t i = 0; i < nsamples; ++i) {
-        float *ip = &m_fbuffer[i * ichannels];
-        for (size_t out = 0; out < m_asbd.mChannelsPerFrame; ++out) {
-            float value = 0.0f;
-            for (size_t in = 0; in < ichannels; ++in) {
-                complex_t factor = m_matrix[out][in];
-                value += ip[in] * (factor.real() + factor.imag());
-            }
-            *op++ = value;
+    for (size_t out = 0; out < m_asbd.mChannelsPerFrame; ++out) {
+        float *op = channels[out];
+        std::fill(op, op + nsamples, 0.0f);
+        for (size_t in = 0; in < ichannels; ++in) {
+            complex_t factor = m_matrix[out][in];
+            float gain = factor.real() + factor.imag();
+            const float *ip = m_input.channel(in);
+            for (size_t i = 0; i < nsamples; ++i)
+                op[i] += ip[i] * gain;
         }
     }
     m_position += nsamples;
     return nsamples;
 }
 
+/*
+ * Reads into m_shifted, and leaves the shifted (or delayed) result in
+ * m_input.
+ */
 size_t MatrixMixer::phaseShift(size_t nsamples)
 {
     const uint32_t ichannels = source()->getSampleFormat().mChannelsPerFrame;
     const size_t pass_channels_size = m_pass_channels.size();
     const size_t shift_channels_size = m_shift_channels.size();
-    const unsigned * const pass_channels =
-        pass_channels_size ? &m_pass_channels[0]: 0;
-    const unsigned * const shift_channels = &m_shift_channels[0];
 
+    m_shifted.resize(ichannels, nsamples);
     size_t ilen = 0, olen = 0;
     do {
-        if (m_buffer.count() == 0) {
-            m_buffer.reserve(nsamples);
-            ilen = readSamplesAsFloat(source(), &m_ibuffer,
-                                      m_buffer.write_ptr(), nsamples);
-            m_buffer.commit(ilen);
-            if (pass_channels_size > 0) {
-                for (size_t i = 0; i < ilen; ++i) {
-                    float *frame = m_buffer.read_ptr() + i * ichannels;
-                    for (unsigned n = 0; n < pass_channels_size; ++n)
-                        m_syncque.push_back(frame[pass_channels[n]]);
-                }
-            }
+        ilen = readSamplesPlanar(source(), &m_ibuffer, &m_fbuffer,
+                                 m_shifted.pointers(), nsamples);
+        for (unsigned n = 0; n < pass_channels_size; ++n) {
+            util::FIFO<float> &que = m_syncque[n];
+            que.reserve(ilen);
+            std::memcpy(que.write_ptr(),
+                        m_shifted.channel(m_pass_channels[n]),
+                        ilen * sizeof(float));
+            que.commit(ilen);
         }
-        float *bp = m_buffer.read_ptr();
         for (unsigned i = 0; i < shift_channels_size; ++i) {
-            unsigned n = shift_channels[i];
-            ilen = m_buffer.count();
+            unsigned n = m_shift_channels[i];
+            size_t ilen_ch = ilen;
             olen = nsamples;
-            float *ip = bp + n;
-            float *op = &m_fbuffer[n];
-            m_filter[i]->process(ip, op, ichannels, ichannels, &ilen, &olen);
+            m_filter[i]->process(m_shifted.channel(n), m_input.channel(n),
+                                 1, 1, &ilen_ch, &olen);
         }
-        m_buffer.advance(ilen);
     } while (ilen != 0 && olen == 0);
 
-    if (pass_channels_size > 0) {
-        float *fp = &m_fbuffer[0];
-        for (size_t i = 0; i < olen; ++i) {
-            float *frame = fp + i * ichannels;
-            for (unsigned n = 0; n < pass_channels_size; ++n) {
-                frame[pass_channels[n]] = m_syncque.front();
-                m_syncque.pop_front();
-            }
-        }
-    }
+    for (unsigned n = 0; n < pass_channels_size; ++n)
+        std::memcpy(m_input.channel(m_pass_channels[n]),
+                    m_syncque[n].read(olen), olen * sizeof(float));
     return olen;
 }
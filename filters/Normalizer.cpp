@@ -75,10 +75,13 @@ size_t Normalizer::processT(size_t nsamples)
 template <typename T>
 size_t Normalizer::readSamplesT(void *buffer, size_t nsamples)
 {
-    if (!m_tmpfile.get())
-        return 0;
-    int nc = util::nread(fd(), buffer, nsamples * m_asbd.mBytesPerFrame);
     T *fp = static_cast<T*>(buffer);
+    int nc;
+    if (m_tmpfile.get())
+        nc = util::nread(fd(), buffer, nsamples * m_asbd.mBytesPerFrame);
+    else
+        nc = readSamplesAsFloat(source(), &m_ibuffer, fp, nsamples)
+            * m_asbd.mBytesPerFrame;
     if (m_peak > FLT_MIN) {
         T peak = m_peak / 0.99609375;
         for (size_t i = 0; i < nc / sizeof(T); ++i)
@@ -11,6 +11,11 @@ class Normalizer: public FilterBase {
     uint64_t m_processed, m_position;
     ca::AudioStreamBasicDescription m_asbd;
 public:
+    /*
+     * When seekable, the first pass only scans the peak. For the second pass,
+     * the caller rewinds the source, and gives a fresh one by setSource().
+     * Otherwise, the first pass is kept in a temporary file.
+     */
     Normalizer(const std::shared_ptr<ISource> &src, bool seekable);
     const ca::AudioStreamBasicDescription &getSampleFormat() const
     {
@@ -18,6 +23,12 @@ public:
     }
     size_t readSamples(void *buffer, size_t nsamples);
     double getPeak() const { return m_peak; }
+    /* instead of process(), when the peak was found elsewhere */
+    void setPeak(double peak, uint64_t length)
+    {
+        m_peak = peak;
+        m_processed = length;
+    }
     size_t process(size_t nsamples);
     int64_t getPosition() { return m_position; }
     uint64_t length() const { return m_processed; }
@@ -1,100 +1,109 @@
 #include "PipedReader.h"
-#ifndef _WIN32
-#include <unistd.h>
-#endif
+#include <cstring>
 
 namespace {
     const int NSAMPLES = 0x1000;
-    const int PIPE_BUF_FACTOR = 4;
 }
 
-PipedReader::PipedReader(std::shared_ptr<ISource> &src):
+PipedReader::PipedReader(std::shared_ptr<ISource> &src, size_t depth):
     FilterBase(src),
-#ifndef _WIN32
-    m_writeFd(-1),
-#endif
+    m_blocks(std::max(depth, static_cast<size_t>(2))),
+    m_head(0),
+    m_tail(0),
+    m_offset(0),
+    m_finished(false),
+    m_quit(false),
+    m_reader_waiting(false),
+    m_writer_waiting(false),
     m_position(0)
 {
     uint32_t bpf = src->getSampleFormat().mBytesPerFrame;
-#ifdef _WIN32
-    HANDLE hr, hw;
-    int fd;
-    FILE *fp;
-    if (!CreatePipe(&hr, &hw, 0, NSAMPLES * bpf * PIPE_BUF_FACTOR))
-        platform::throw_error("CreatePipe", GetLastError());
-    CHECKCRT((fd = _open_osfhandle(reinterpret_cast<intptr_t>(hr),
-                                   _O_RDONLY|_O_BINARY)) < 0);
-    CHECKCRT((fp = _fdopen(fd, "rb")) == 0);
-    m_readPipe.reset(fp, std::fclose);
-    m_writePipe.reset(hw, CloseHandle);
-#else
-    int fds[2];
-    if (pipe(fds) != 0)
-        util::throw_crt_error("pipe");
-    FILE *fp = fdopen(fds[0], "rb");
-    if (!fp) util::throw_crt_error("fdopen");
-    m_readPipe.reset(fp, std::fclose);
-    m_writeFd = fds[1];
-#endif
+    for (size_t i = 0; i < m_blocks.size(); ++i) {
+        m_blocks[i].data.resize(NSAMPLES * bpf);
+        m_blocks[i].nsamples = 0;
+    }
 }
 
 PipedReader::~PipedReader()
 {
     if (m_thread.joinable()) {
-        m_readPipe.reset();
+        m_quit = true;
+        wake(m_writer_waiting);
         m_thread.join();
     }
-#ifndef _WIN32
-    if (m_writeFd >= 0)
-        close(m_writeFd);
-#endif
 }
 
 size_t PipedReader::readSamples(void *buffer, size_t nsamples)
 {
     uint32_t bpf = source()->getSampleFormat().mBytesPerFrame;
-    ssize_t nread = 0;
-    if (m_readPipe.get()) {
-        nread = util::nread(fileno(m_readPipe.get()), buffer, nsamples * bpf);
-        if (nread == 0)
-            m_readPipe.reset();
+    uint8_t *bp = static_cast<uint8_t*>(buffer);
+    size_t n = 0, count;
+    const void *data;
+    while (n < nsamples && (count = readBlock(&data, nsamples - n)) > 0) {
+        std::memcpy(bp + n * bpf, data, count * bpf);
+        n += count;
+    }
+    return n;
+}
+
+size_t PipedReader::readBlock(const void **data, size_t nsamples)
+{
+    releaseBlock();
+    size_t head = m_head.load(std::memory_order_relaxed);
+    wait(m_reader_waiting, [&]() {
+        return m_tail.load() != head || m_finished.load();
+    });
+    if (m_tail.load() == head) {
+        if (m_error)
+            std::rethrow_exception(m_error);
+        return 0;
     }
-    nsamples = nread / bpf;
+    uint32_t bpf = source()->getSampleFormat().mBytesPerFrame;
+    Block &block = m_blocks[head % m_blocks.size()];
+    nsamples = std::min(nsamples, block.nsamples - m_offset);
+    *data = &block.data[m_offset * bpf];
+    m_offset += nsamples;
     m_position += nsamples;
     return nsamples;
 }
 
+/*
+ * Give back the head block to the reader thread once it has been
+ * consumed entirely. This is deferred to the next read, since the last
+ * view returned by readBlock() points into it.
+ */
+void PipedReader::releaseBlock()
+{
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (m_offset && m_offset == m_blocks[head % m_blocks.size()].nsamples) {
+        m_offset = 0;
+        m_head.store(head + 1);
+        wake(m_writer_waiting);
+    }
+}
+
 void PipedReader::inputThreadProc()
 {
     try {
         ISource *src = source();
-        uint32_t bpf = src->getSampleFormat().mBytesPerFrame;
-        std::vector<uint8_t> buffer(NSAMPLES * bpf);
-        uint8_t *bp = &buffer[0];
-        size_t n;
-#ifdef _WIN32
-        HANDLE ph = m_writePipe.get();
-        DWORD nb;
-        while ((n = src->readSamples(bp, NSAMPLES)) > 0
-               && WriteFile(ph, bp, n * bpf, &nb, 0))
-            ;
-#else
-        while ((n = src->readSamples(bp, NSAMPLES)) > 0) {
-            size_t nbytes = n * bpf;
-            size_t off = 0;
-            bool ok = true;
-            while (off < nbytes) {
-                ssize_t w = write(m_writeFd, bp + off, nbytes - off);
-                if (w <= 0) { ok = false; break; }
-                off += static_cast<size_t>(w);
-            }
-            if (!ok) break;
+        size_t depth = m_blocks.size();
+        for (;;) {
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            wait(m_writer_waiting, [&]() {
+                return tail - m_head.load() < depth || m_quit.load();
+            });
+            if (m_quit)
+                break;
+            Block &block = m_blocks[tail % depth];
+            block.nsamples = src->readSamples(block.data.data(), NSAMPLES);
+            if (!block.nsamples)
+                break;
+            m_tail.store(tail + 1);
+            wake(m_reader_waiting);
         }
-#endif
-    } catch (...) {}
-#ifdef _WIN32
-    m_writePipe.reset(); // close
-#else
-    if (m_writeFd >= 0) { close(m_writeFd); m_writeFd = -1; }
-#endif
+    } catch (...) {
+        m_error = std::current_exception();
+    }
+    m_finished = true;
+    wake(m_reader_waiting);
 }
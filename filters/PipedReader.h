@@ -2,29 +2,68 @@
 #define PIPED_READER_H
 
 #include "FilterBase.h"
-#include "platformutil.h"
+#include "logging.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 
-class PipedReader: public FilterBase {
-    std::shared_ptr<FILE> m_readPipe;
-#ifdef _WIN32
-    std::shared_ptr<void> m_writePipe;
-#else
-    int m_writeFd;
-#endif
+/*
+ * Reads the source on a separate thread.
+ *
+ * Samples are handed over through a single-producer/single-consumer ring
+ * of preallocated blocks. Ring positions are atomics; the mutex is taken
+ * only to sleep (and wake the other side) when the ring is empty or full.
+ */
+class PipedReader: public FilterBase, public IBlockSource {
+    struct Block {
+        std::vector<uint8_t> data;
+        size_t nsamples;
+    };
+    std::vector<Block> m_blocks;
+    std::atomic<size_t> m_head; /* next block to be consumed */
+    std::atomic<size_t> m_tail; /* next block to be filled */
+    size_t m_offset;            /* samples already consumed in head block */
+    std::atomic<bool> m_finished;
+    std::atomic<bool> m_quit;
+    std::atomic<bool> m_reader_waiting;
+    std::atomic<bool> m_writer_waiting;
+    std::exception_ptr m_error;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
     std::thread m_thread;
     int64_t m_position;
 public:
-    PipedReader(std::shared_ptr<ISource> &src);
+    PipedReader(std::shared_ptr<ISource> &src, size_t depth=4);
     ~PipedReader();
     size_t readSamples(void *buffer, size_t nsamples);
+    size_t readBlock(const void **data, size_t nsamples);
+    /* no-op if already started */
     void start()
     {
-        m_thread = std::thread(&PipedReader::inputThreadProc, this);
+        if (!m_thread.joinable())
+            m_thread = Log::start_thread(&PipedReader::inputThreadProc, this);
     }
     int64_t getPosition() { return m_position; }
 private:
     void inputThreadProc();
+    void releaseBlock();
+    template <typename Pred>
+    void wait(std::atomic<bool> &waiting, Pred ready)
+    {
+        if (ready()) return;
+        waiting = true;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, ready);
+        waiting = false;
+    }
+    void wake(std::atomic<bool> &waiting)
+    {
+        if (waiting) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_cond.notify_all();
+        }
+    }
 };
 
 #endif
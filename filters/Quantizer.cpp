@@ -1,6 +1,7 @@
 #include <climits>
 #include "Quantizer.h"
 #include "ascutil.h"
+#include "simdutil.h"
 
 template <typename T>
 inline T clip(T x, T min, T max)
@@ -10,37 +11,10 @@ inline T clip(T x, T min, T max)
     return x;
 }
 
-/* inacculate, but much faster than std::uniform_int_distribution<> */
-template <typename Engine>
-class RandomIntSpan {
-    Engine &e_;
-    int div_, off_;
-public:
-    RandomIntSpan(Engine &e, int min, int max)
-        : e_(e), off_(min)
-    {
-        div_ = e.max() / (max - min);
-    }
-    int operator()() { return e_() / div_ + off_; }
-};
-
-template <typename Engine>
-class RandomIntSpanShift {
-    Engine &e_;
-    int shift_, off_;
-public:
-    RandomIntSpanShift(Engine &e, int log2)
-        : e_(e)
-    {
-        shift_ = 32 - log2;
-        off_ = - (1 << (log2 - 1));
-    }
-    int operator()() { return (e_() >> shift_) + off_; }
-};
-
 Quantizer::Quantizer(const std::shared_ptr<ISource> &source,
-                     uint32_t bitdepth, bool no_dither, bool is_float)
-    : FilterBase(source)
+                     uint32_t bitdepth, bool no_dither, bool is_float,
+                     double scale)
+    : FilterBase(source), m_scale(scale)
 {
     const ca::AudioStreamBasicDescription &asbd = source->getSampleFormat();
     m_asbd = ascutil::buildASBDForPCM2(asbd.mSampleRate,
@@ -53,6 +27,15 @@ Quantizer::Quantizer(const std::shared_ptr<ISource> &source,
 
     if (m_asbd.mFormatFlags & kAudioFormatFlagIsFloat)
         m_convert = &Quantizer::convertSamples_a2f;
+    else if ((asbd.mFormatFlags & kAudioFormatFlagIsSignedInteger) &&
+             scale != 1.0) {
+        if (asbd.mBitsPerChannel > 24)
+            m_convert = dither ? &Quantizer::convertSamples_f2i<double, true>
+                               : &Quantizer::convertSamples_f2i<double, false>;
+        else
+            m_convert = dither ? &Quantizer::convertSamples_f2i<float, true>
+                               : &Quantizer::convertSamples_f2i<float, false>;
+    }
     else if (asbd.mFormatFlags & kAudioFormatFlagIsSignedInteger) {
         if (m_asbd.mBitsPerChannel >= asbd.mBitsPerChannel)
             m_convert = &Quantizer::convertSamples_i2i_0;
@@ -61,21 +44,24 @@ Quantizer::Quantizer(const std::shared_ptr<ISource> &source,
         else
             m_convert = &Quantizer::convertSamples_i2i_1;
     }
-    else if (asbd.mBitsPerChannel == 16)
-        m_convert = dither ? &Quantizer::convertSamples_h2i_2
-                           : &Quantizer::convertSamples_h2i_1;
     else if (asbd.mBitsPerChannel <= 32)
-        m_convert = dither ? &Quantizer::convertSamples_f2i_2
-                           : &Quantizer::convertSamples_f2i_1;
+        m_convert = dither ? &Quantizer::convertSamples_f2i<float, true>
+                           : &Quantizer::convertSamples_f2i<float, false>;
     else
-        m_convert = dither ? &Quantizer::convertSamples_d2i_2
-                           : &Quantizer::convertSamples_d2i_1;
+        m_convert = dither ? &Quantizer::convertSamples_f2i<double, true>
+                           : &Quantizer::convertSamples_f2i<double, false>;
 }
 
 size_t Quantizer::convertSamples_a2f(void *buffer, size_t nsamples)
 {
-    return readSamplesAsFloat(source(), &m_pivot,
-                              static_cast<float*>(buffer), nsamples);
+    float *fp = static_cast<float*>(buffer);
+    nsamples = readSamplesAsFloat(source(), &m_pivot, fp, nsamples);
+    if (m_scale != 1.0) {
+        size_t count = nsamples * m_asbd.mChannelsPerFrame;
+        for (size_t i = 0; i < count; ++i)
+            fp[i] *= m_scale;
+    }
+    return nsamples;
 }
 
 size_t Quantizer::convertSamples_i2i_0(void *buffer, size_t nsamples)
@@ -101,67 +87,29 @@ size_t Quantizer::convertSamples_i2i_2(void *buffer, size_t nsamples)
     return nsamples;
 }
 
-size_t Quantizer::convertSamples_h2i_1(void *buffer, size_t nsamples)
-{
-    nsamples = readSamplesAsFloat(source(), &m_pivot,
-                                  static_cast<float*>(buffer), nsamples);
-    ditherFloat1(static_cast<float *>(buffer),
-                 static_cast<int32_t *>(buffer),
-                 m_asbd.mChannelsPerFrame * nsamples,
-                 m_asbd.mBitsPerChannel);
-    return nsamples;
-}
-
-size_t Quantizer::convertSamples_h2i_2(void *buffer, size_t nsamples)
+template <>
+const float *Quantizer::readFloatSamples<float>(void *buffer,
+                                                size_t *nsamples)
 {
-    nsamples = readSamplesAsFloat(source(), &m_pivot,
-                                  static_cast<float*>(buffer), nsamples);
-    ditherFloat2(static_cast<float *>(buffer),
-                 static_cast<int32_t *>(buffer),
-                 m_asbd.mChannelsPerFrame * nsamples,
-                 m_asbd.mBitsPerChannel);
-    return nsamples;
+    float *fp = static_cast<float*>(buffer);
+    *nsamples = readSamplesAsFloat(source(), &m_pivot, fp, *nsamples);
+    return fp;
 }
 
-size_t Quantizer::convertSamples_f2i_1(void *buffer, size_t nsamples)
+template <>
+const double *Quantizer::readFloatSamples<double>(void *, size_t *nsamples)
 {
-    nsamples = source()->readSamples(buffer, nsamples);
-    ditherFloat1(static_cast<float *>(buffer),
-                 static_cast<int32_t *>(buffer),
-                 m_asbd.mChannelsPerFrame * nsamples,
-                 m_asbd.mBitsPerChannel);
-    return nsamples;
+    *nsamples = readSamplesAsFloat(source(), &m_pivot, &m_dbuffer, *nsamples);
+    return m_dbuffer.data();
 }
 
-size_t Quantizer::convertSamples_f2i_2(void *buffer, size_t nsamples)
+template <typename T, bool Dither>
+size_t Quantizer::convertSamples_f2i(void *buffer, size_t nsamples)
 {
-    nsamples = source()->readSamples(buffer, nsamples);
-    ditherFloat2(static_cast<float *>(buffer),
-                 static_cast<int32_t *>(buffer),
-                 m_asbd.mChannelsPerFrame * nsamples,
-                 m_asbd.mBitsPerChannel);
-    return nsamples;
-}
-
-size_t Quantizer::convertSamples_d2i_1(void *buffer, size_t nsamples)
-{
-    growPivot(nsamples);
-    nsamples = source()->readSamples(&m_pivot[0], nsamples);
-    ditherFloat1(reinterpret_cast<double *>(&m_pivot[0]),
-                 static_cast<int32_t *>(buffer),
-                 m_asbd.mChannelsPerFrame * nsamples,
-                 m_asbd.mBitsPerChannel);
-    return nsamples;
-}
-
-size_t Quantizer::convertSamples_d2i_2(void *buffer, size_t nsamples)
-{
-    growPivot(nsamples);
-    nsamples = source()->readSamples(&m_pivot[0], nsamples);
-    ditherFloat2(reinterpret_cast<double *>(&m_pivot[0]),
-                 static_cast<int32_t *>(buffer),
-                 m_asbd.mChannelsPerFrame * nsamples,
-                 m_asbd.mBitsPerChannel);
+    const T *src = readFloatSamples<T>(buffer, &nsamples);
+    ditherFloat<T, Dither>(src, static_cast<int32_t *>(buffer),
+                           m_asbd.mChannelsPerFrame * nsamples,
+                           m_asbd.mBitsPerChannel);
     return nsamples;
 }
 
@@ -193,48 +141,58 @@ void Quantizer::ditherInt2(int32_t *dst, size_t count, unsigned bits)
     const int half = one / 2;
     const unsigned mask = ~(one - 1);
 
-    RandomIntSpanShift<RandomEngine> noise(m_engine, 31 - bits);
+    /* two draws from [-one/2, one/2) per sample */
+    const uint32_t *r = randomBits(count * 2);
+    const unsigned shift = bits + 1;
     for (size_t i = 0; i < count; ++i) {
-        int value = (dst[i] >> 1) + half + noise() + noise();
+        int noise = static_cast<int>(r[i] >> shift) +
+                    static_cast<int>(r[count + i] >> shift) - one;
+        int value = (dst[i] >> 1) + half + noise;
         value &= mask;
         dst[i] = clip(value, INT_MIN>>1, INT_MAX>>1) << 1;
     }
 }
 
-template <typename T>
-void Quantizer::ditherFloat1(const T *src, int32_t *dst, size_t count,
-                             unsigned bits)
+/*
+ * Vector kernel for the bulk, then the same arithmetic on the tail.
+ * With Dither, TPDF noise of +-1 LSB is added before rounding.
+ */
+template <typename T, bool Dither>
+void Quantizer::ditherFloat(const T *src, int32_t *dst, size_t count,
+                            unsigned bits)
 {
     int shifts = 32 - bits;
     double half = static_cast<double>(1U << (bits - 1));
     double min_value = -half;
     double max_value = half - 1;
-    for (size_t i = 0; i < count; ++i) {
-        double value = src[i] * half;
+    double gain = half * m_scale;
+    const float *noise = Dither ? triangularNoise(count) : 0;
+    size_t i = simdutil::quantize(src, noise, dst, count, gain,
+                                  min_value, max_value, shifts);
+    for (; i < count; ++i) {
+        double value = src[i] * gain;
+        if (Dither)
+            value += noise[i];
         dst[i] = lrint(clip(value, min_value, max_value)) << shifts;
     }
 }
 
-template <typename T>
-void Quantizer::ditherFloat2(const T *src, int32_t *dst, size_t count,
-                             unsigned bits)
+/* count random words, in blocks of four */
+const uint32_t *Quantizer::randomBits(size_t count)
 {
-    int shifts = 32 - bits;
-    double half = static_cast<double>(1U << (bits - 1));
-    double min_value = -half;
-    double max_value = half - 1;
-    std::uniform_real_distribution<double> dist(-0.5, 0.5);
-    for (size_t i = 0; i < count; ++i) {
-        double value = src[i] * half;
-        double noise = dist(m_engine) + dist(m_engine);
-        value += noise;
-        dst[i] = lrint(clip(value, min_value, max_value)) << shifts;
-    }
+    m_random.resize((count + 3) & ~3);
+    m_engine.generate(m_random.data(), m_random.size());
+    return m_random.data();
 }
 
-void Quantizer::growPivot(size_t nsamples)
+/* sum of two uniform values in [-0.5, 0.5) */
+const float *Quantizer::triangularNoise(size_t count)
 {
-    size_t nbytes = nsamples * source()->getSampleFormat().mBytesPerFrame;
-    if (m_pivot.size() < nbytes)
-        m_pivot.resize(nbytes);
+    const uint32_t *r = randomBits(count * 2);
+    const float k = 1.0f / 4294967296.0f;
+    m_noise.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        m_noise[i] = static_cast<int32_t>(r[i]) * k +
+                     static_cast<int32_t>(r[count + i]) * k;
+    return m_noise.data();
 }
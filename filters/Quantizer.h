@@ -2,20 +2,26 @@
 #define INTEGER_SOURCE_H
 
 #include <assert.h>
-#include <random>
 #include "FilterBase.h"
 #include "cautil.h"
 #include "rng.h"
 
 class Quantizer: public FilterBase {
-    typedef rng::LCG RandomEngine;
+    typedef rng::Xor128x4 RandomEngine;
     ca::AudioStreamBasicDescription m_asbd;
     RandomEngine m_engine;
+    double m_scale;
     std::vector<uint8_t> m_pivot;
+    std::vector<double> m_dbuffer;
+    std::vector<uint32_t> m_random;
+    std::vector<float> m_noise;
     size_t (Quantizer::*m_convert)(void *buffer, size_t nsamples);
 public:
+    /*
+     * scale is a gain applied in the same pass (instead of a Scaler).
+     */
     Quantizer(const std::shared_ptr<ISource> &source, uint32_t bitdepth,
-              bool no_dither, bool is_float=false);
+              bool no_dither, bool is_float=false, double scale=1.0);
     const ca::AudioStreamBasicDescription &getSampleFormat() const
     {
         return m_asbd;
@@ -29,21 +35,19 @@ private:
     size_t convertSamples_i2i_0(void *buffer, size_t nsamples);
     size_t convertSamples_i2i_1(void *buffer, size_t nsamples);
     size_t convertSamples_i2i_2(void *buffer, size_t nsamples);
-    size_t convertSamples_h2i_1(void *buffer, size_t nsamples);
-    size_t convertSamples_h2i_2(void *buffer, size_t nsamples);
-    size_t convertSamples_f2i_1(void *buffer, size_t nsamples);
-    size_t convertSamples_f2i_2(void *buffer, size_t nsamples);
-    size_t convertSamples_d2i_1(void *buffer, size_t nsamples);
-    size_t convertSamples_d2i_2(void *buffer, size_t nsamples);
+    /* half/float (T = float) or double source */
+    template <typename T, bool Dither>
+    size_t convertSamples_f2i(void *buffer, size_t nsamples);
+    template <typename T>
+    const T *readFloatSamples(void *buffer, size_t *nsamples);
 
     void ditherInt1(int32_t *dst, size_t count, unsigned bits);
     void ditherInt2(int32_t *dst, size_t count, unsigned bits);
-    template <typename T>
-    void ditherFloat1(const T *src, int *dst, size_t count, unsigned bits);
-    template <typename T>
-    void ditherFloat2(const T *src, int *dst, size_t count, unsigned bits);
+    template <typename T, bool Dither>
+    void ditherFloat(const T *src, int *dst, size_t count, unsigned bits);
 
-    void growPivot(size_t nsamples);
+    const uint32_t *randomBits(size_t count);
+    const float *triangularNoise(size_t count);
 };
 
 #endif
@@ -10,7 +10,6 @@ SoxLowpassFilter::SoxLowpassFilter(const std::shared_ptr<ISource> &src,
     const ca::AudioStreamBasicDescription &asbd = src->getSampleFormat();
     m_asbd = ascutil::buildASBDForPCM(asbd.mSampleRate, asbd.mChannelsPerFrame,
                                      32, kAudioFormatFlagIsFloat);
-    m_buffer.set_unit(m_asbd.mChannelsPerFrame);
 
     double Fn = asbd.mSampleRate / 2.0;
     double Fs = Fp + asbd.mSampleRate * 0.0125;
@@ -24,27 +23,27 @@ SoxLowpassFilter::SoxLowpassFilter(const std::shared_ptr<ISource> &src,
 }
 
 size_t SoxLowpassFilter::readSamples(void *buffer, size_t nsamples)
+{
+    m_obuffer.resize(m_asbd.mChannelsPerFrame, nsamples);
+    nsamples = readPlanar(m_obuffer.pointers(), nsamples);
+    m_obuffer.interleave(static_cast<float *>(buffer), nsamples);
+    return nsamples;
+}
+
+size_t SoxLowpassFilter::readPlanar(float * const *channels, size_t nsamples)
 {
     uint32_t nchannels = m_asbd.mChannelsPerFrame;
     size_t ilen = 0, olen = 0;
+    m_ibuffer.resize(nchannels, nsamples);
     do {
-        if (m_buffer.count() == 0) {
-            m_buffer.reserve(nsamples);
-            size_t n = readSamplesAsFloat(source(), &m_pivot,
-                                          m_buffer.write_ptr(), nsamples);
-            m_buffer.commit(n);
-        }
-        ilen = m_buffer.count();
-        olen = nsamples;
+        ilen = readSamplesPlanar(source(), &m_pivot, &m_fbuffer,
+                                 m_ibuffer.pointers(), nsamples);
         for (uint32_t ch = 0; ch < nchannels; ++ch) {
             size_t ilen_ch = ilen, olen_ch = nsamples;
-            m_convolvers[ch]->process(m_buffer.read_ptr() + ch,
-                                      static_cast<float *>(buffer) + ch,
-                                      nchannels, nchannels,
-                                      &ilen_ch, &olen_ch);
+            m_convolvers[ch]->process(m_ibuffer.channel(ch), channels[ch],
+                                      1, 1, &ilen_ch, &olen_ch);
             olen = olen_ch;
         }
-        m_buffer.advance(ilen);
     } while (ilen != 0 && olen == 0);
 
     m_position += olen;
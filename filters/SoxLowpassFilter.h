@@ -7,10 +7,11 @@
 #include "FilterBase.h"
 #include "util.h"
 
-class SoxLowpassFilter: public FilterBase {
+class SoxLowpassFilter: public FilterBase, public IPlanarSource {
     int64_t m_position;
     std::vector<uint8_t> m_pivot;
-    util::FIFO<float> m_buffer;
+    std::vector<float> m_fbuffer;
+    util::PlanarBuffer m_ibuffer, m_obuffer;
     std::vector<std::unique_ptr<StreamingConvolver> > m_convolvers;
     ca::AudioStreamBasicDescription m_asbd;
 public:
@@ -20,6 +21,7 @@ public:
         return m_asbd;
     }
     size_t readSamples(void *buffer, size_t nsamples);
+    size_t readPlanar(float * const *channels, size_t nsamples);
     int64_t getPosition() { return m_position; }
 };
 
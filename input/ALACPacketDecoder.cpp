@@ -18,33 +18,33 @@ ALACPacketDecoder::ALACPacketDecoder(const ca::AudioStreamBasicDescription &asbd
                                        asbd.mChannelsPerFrame, valid_bits, 32,
                                        kAudioFormatFlagIsSignedInteger);
     m_decoder = std::make_shared<ALACDecoder>();
-    uint32_t bpf =
-        (m_oasbd.mBitsPerChannel + 7) / 8 * m_oasbd.mChannelsPerFrame;
-    m_raw_decode_buffer.resize(bpf * asbd.mFramesPerPacket);
+    m_decoder->SetAlignedOutput(true);
 }
 
 size_t ALACPacketDecoder::decode(const std::vector<uint8_t> &packet, std::vector<uint8_t> *samples)
 {
-    if (packet.empty()) {
-        samples->resize(0);
+    samples->resize(m_iasbd.mFramesPerPacket * m_oasbd.mBytesPerFrame);
+    size_t n = decodeTo(packet, samples->data());
+    samples->resize(n * m_oasbd.mBytesPerFrame);
+    return n;
+}
+
+/*
+ * ALACDecoder writes 32-bit samples MSB aligned, which is m_oasbd as is.
+ */
+size_t ALACPacketDecoder::decodeTo(const std::vector<uint8_t> &packet, void *buffer)
+{
+    if (packet.empty())
         return 0;
-    }
     BitBuffer bits;
     BitBufferInit(&bits, const_cast<uint8_t*>(packet.data()), packet.size());
     uint32_t ncount;
     int err;
-    if ((err = m_decoder->Decode(&bits, m_raw_decode_buffer.data(),
+    if ((err = m_decoder->Decode(&bits, static_cast<uint8_t*>(buffer),
         m_iasbd.mFramesPerPacket,
         m_iasbd.mChannelsPerFrame,
         &ncount)) != 0) {
         throw std::runtime_error(strutil::format("ALACDecoder: decode error: %d", err));
     }
-    uint32_t bpf =
-        (m_oasbd.mBitsPerChannel + 7) / 8 * m_oasbd.mChannelsPerFrame;
-    size_t nbytes = ncount * bpf;
-    samples->resize(ncount * m_oasbd.mBytesPerFrame);
-    util::unpack(m_raw_decode_buffer.data(), samples->data(),
-                    &nbytes, bpf / m_oasbd.mChannelsPerFrame, 4);
     return ncount;
 }
-
@@ -5,10 +5,9 @@
 #include <ALACDecoder.h>
 #include "PacketDecoder.h"
 
-class ALACPacketDecoder: public IPacketDecoder {
+class ALACPacketDecoder: public IPacketDecoder, public IDirectPacketDecoder {
     ca::AudioStreamBasicDescription m_iasbd, m_oasbd;
     std::shared_ptr<ALACDecoder> m_decoder;
-    std::vector<uint8_t> m_raw_decode_buffer;
 public:
     ALACPacketDecoder(const ca::AudioStreamBasicDescription &asbd);
     void reset() {}
@@ -21,6 +20,8 @@ public:
         m_decoder->Init(const_cast<uint8_t*>(cookie.data()), cookie.size());
     }
     virtual size_t decode(const std::vector<uint8_t> &packet, std::vector<uint8_t> *samples);
+    size_t maxFramesPerPacket() const { return m_iasbd.mFramesPerPacket; }
+    size_t decodeTo(const std::vector<uint8_t> &packet, void *buffer);
 };
 
 #endif
@@ -16,12 +16,14 @@
 #include "ascutil.h"
 #include "chanmap.h"
 
-CAFSource::CAFSource(std::shared_ptr<IInputStream> stream)
+CAFSource::CAFSource(std::shared_ptr<IInputStream> stream,
+                     unsigned decode_threads)
     : m_position(0)
     , m_position_raw(0)
     , m_currentPacket(0)
     , m_start_skip(0)
     , m_packetsPerChunk(1)
+    , m_decodeThreads(decode_threads)
 {
     m_file = std::make_shared<CAFFile>(stream);
     for (auto &&e: m_file->get_tags()) {
@@ -41,20 +43,42 @@ CAFSource::CAFSource(std::shared_ptr<IInputStream> stream)
         default:     throw std::runtime_error("Not supported input codec");
     }
     m_decodeBuffer.set_unit(m_oasbd.mBytesPerFrame);
+    m_directDecoder = m_decodeAhead ? nullptr
+                    : dynamic_cast<IDirectPacketDecoder*>(m_decoder.get());
 }
 
+/*
+ * With nothing buffered and room for a whole packet, decode straight into
+ * the caller's buffer.
+ */
 size_t CAFSource::readSamples(void *buffer, size_t nsamples)
 {
-    auto &&asbd = m_file->format().asbd;
+    if (m_directDecoder && m_decodeBuffer.count() == 0 &&
+        nsamples >= m_directDecoder->maxFramesPerPacket() &&
+        m_position < m_file->duration()) {
+        bool ok = readPacket(&m_packetBuffer);
+        int64_t n = m_directDecoder->decodeTo(m_packetBuffer, buffer);
+        n = std::min<int64_t>(n, m_file->duration() - m_position);
+        if (n > 0 || !ok) {
+            m_position += n;
+            return n;
+        }
+    }
+    const void *data;
+    nsamples = readBlock(&data, nsamples);
+    std::memcpy(buffer, data, nsamples * m_oasbd.mBytesPerFrame);
+    return nsamples;
+}
+
+size_t CAFSource::readBlock(const void **data, size_t nsamples)
+{
     if (m_decodeBuffer.count() == 0) {
         fillDecodeBuffer();
     }
     if (nsamples > m_decodeBuffer.count())
         nsamples = m_decodeBuffer.count();
-    if (nsamples > 0) {
-        std::memcpy(buffer, m_decodeBuffer.read(nsamples), nsamples * m_oasbd.mBytesPerFrame);
-        m_position += nsamples;
-    }
+    *data = m_decodeBuffer.read(nsamples);
+    m_position += nsamples;
     return nsamples;
 }
 
@@ -64,6 +88,8 @@ void CAFSource::seekTo(int64_t count)
     auto &&asbd = m_file->format().asbd;
     m_position = count;
     m_decoder->reset();
+    if (m_decodeAhead)
+        m_decodeAhead->reset();
     int64_t offsetInMediaTime = m_position + m_file->start_offset();
     m_currentPacket = std::max<int64_t>((offsetInMediaTime - getMaxFrameDependency() * asbd.mFramesPerPacket) / asbd.mFramesPerPacket, 0LL);
     int prerollSamples = offsetInMediaTime - m_currentPacket * asbd.mFramesPerPacket;
@@ -93,20 +119,46 @@ bool CAFSource::readPacket(std::vector<uint8_t> *buffer)
 void CAFSource::fillDecodeBuffer()
 {
     while (m_decodeBuffer.count() == 0) {
-        bool ok = readPacket(&m_packetBuffer);
-        int nsamples = m_decoder->decode(m_packetBuffer, &m_rawDecodeBuffer);
+        int nsamples;
+        bool ok = decodePacket(&nsamples);
         if (m_position + m_decodeBuffer.count() + nsamples > m_file->duration()) {
             nsamples = std::max<int64_t>(0LL, m_file->duration() - m_position - int(m_decodeBuffer.count()));
         }
         if (!ok && nsamples == 0) break;
-        if (nsamples > 0) {
-            m_decodeBuffer.reserve(nsamples);
-            std::memcpy(m_decodeBuffer.write_ptr(), m_rawDecodeBuffer.data(), m_rawDecodeBuffer.size());
+        if (nsamples > 0)
             m_decodeBuffer.commit(nsamples);
-        }
     }
 }
 
+/*
+ * Decode the next packet to the write end of m_decodeBuffer, through the
+ * decode-ahead queue if any, without committing it.
+ * Returns false at the end of the stream.
+ */
+bool CAFSource::decodePacket(int *nsamples)
+{
+    if (m_directDecoder) {
+        bool ok = readPacket(&m_packetBuffer);
+        m_decodeBuffer.reserve(m_directDecoder->maxFramesPerPacket());
+        *nsamples = m_directDecoder->decodeTo(m_packetBuffer, m_decodeBuffer.write_ptr());
+        return ok;
+    }
+    bool ok;
+    if (m_decodeAhead) {
+        while (m_decodeAhead->pending() < m_decodeAhead->depth() &&
+               readPacket(&m_packetBuffer))
+            m_decodeAhead->submit(&m_packetBuffer);
+        ok = m_decodeAhead->pending() > 0;
+        *nsamples = m_decodeAhead->receive(&m_rawDecodeBuffer);
+    } else {
+        ok = readPacket(&m_packetBuffer);
+        *nsamples = m_decoder->decode(m_packetBuffer, &m_rawDecodeBuffer);
+    }
+    m_decodeBuffer.reserve(*nsamples);
+    std::memcpy(m_decodeBuffer.write_ptr(), m_rawDecodeBuffer.data(), *nsamples * m_oasbd.mBytesPerFrame);
+    return ok;
+}
+
 void CAFSource::setupLPCM()
 {
     auto &&asbd = m_file->format().asbd;
@@ -125,16 +177,20 @@ void CAFSource::setupALAC()
 {
     std::vector<std::uint8_t> cookie;
     m_file->get_magic_cookie(&cookie);
-    auto &&asbd = m_file->format().asbd;
-
+    ca::AudioStreamBasicDescription asbd = m_file->format().asbd;
+    auto createDecoder = [asbd, cookie]() -> std::shared_ptr<IPacketDecoder> {
 #ifdef QAAC
-    m_decoder = std::make_shared<CoreAudioPacketDecoder>(cautil::toNative(asbd));
-    m_decoder->setMagicCookie(cookie);
+        auto decoder = std::make_shared<CoreAudioPacketDecoder>(cautil::toNative(asbd));
 #else
-    m_decoder = std::make_shared<ALACPacketDecoder>(asbd);
-    m_decoder->setMagicCookie(cookie);
+        auto decoder = std::make_shared<ALACPacketDecoder>(asbd);
 #endif
+        decoder->setMagicCookie(cookie);
+        return decoder;
+    };
+    m_decoder = createDecoder();
     m_oasbd = m_decoder->getSampleFormat();
+    if (m_decodeThreads > 1)
+        m_decodeAhead = std::make_shared<DecodeAheadQueue>(createDecoder, m_decodeThreads);
     if (m_chanmap.empty()) {
         AudioChannelLayout acl = { 0 };
         acl.mChannelLayoutTag = chanmap::getALACChannelLayoutTag(asbd.mChannelsPerFrame);
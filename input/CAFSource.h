@@ -5,9 +5,11 @@
 #include "PacketDecoder.h"
 #include "IInputStream.h"
 #include "CAFFile.h"
+#include "DecodeAheadQueue.h"
 #include "util.h"
 
-class CAFSource: public ISeekableSource, public ITagParser
+class CAFSource: public ISeekableSource, public IBlockSource,
+    public ITagParser
 {
     int64_t  m_position, m_position_raw;
     int64_t  m_currentPacket;
@@ -15,6 +17,9 @@ class CAFSource: public ISeekableSource, public ITagParser
     unsigned m_packetsPerChunk;
     std::shared_ptr<CAFFile> m_file;
     std::shared_ptr<IPacketDecoder>    m_decoder;
+    std::shared_ptr<DecodeAheadQueue>  m_decodeAhead;
+    IDirectPacketDecoder               *m_directDecoder;
+    unsigned m_decodeThreads;
     std::map<std::string, std::string> m_tags;
     std::vector<uint32_t> m_chanmap;
     std::vector<uint8_t> m_packetBuffer;
@@ -22,7 +27,11 @@ class CAFSource: public ISeekableSource, public ITagParser
     util::FIFO<uint8_t>  m_decodeBuffer;
     ca::AudioStreamBasicDescription m_oasbd;
 public:
-    CAFSource(std::shared_ptr<IInputStream> stream);
+    /*
+     * decode_threads > 1 decodes ALAC packets ahead on that many threads.
+     */
+    CAFSource(std::shared_ptr<IInputStream> stream,
+              unsigned decode_threads=0);
     uint64_t length() const
     {
         auto len = m_file->duration();
@@ -38,10 +47,12 @@ public:
     }
     int64_t getPosition() { return m_position; }
     size_t readSamples(void *buffer, size_t nsamples);
+    size_t readBlock(const void **data, size_t nsamples);
     void seekTo(int64_t count);
     const std::map<std::string, std::string> &getTags() const { return m_tags; }
 private:
     bool readPacket(std::vector<uint8_t> *buffer);
+    bool decodePacket(int *nsamples);
     void fillDecodeBuffer();
     void setupLPCM();
     void setupALAC();
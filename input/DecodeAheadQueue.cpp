@@ -0,0 +1,91 @@
+#include "DecodeAheadQueue.h"
+
+DecodeAheadQueue::DecodeAheadQueue(const DecoderFactory &factory,
+                                   unsigned nthreads)
+    : m_depth(nthreads * 2), m_quit(false)
+{
+    for (unsigned i = 0; i < nthreads; ++i)
+        m_workers.push_back(std::thread(&DecodeAheadQueue::run, this,
+                                        factory()));
+}
+
+DecodeAheadQueue::~DecodeAheadQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_cond.notify_all();
+    for (size_t i = 0; i < m_workers.size(); ++i)
+        m_workers[i].join();
+}
+
+void DecodeAheadQueue::submit(std::vector<uint8_t> *packet)
+{
+    std::shared_ptr<Item> item = std::make_shared<Item>();
+    item->packet.swap(*packet);
+    item->log = Log::instance().get_thread_buffer();
+    m_items.push_back(item);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(item);
+    }
+    m_cond.notify_all();
+}
+
+size_t DecodeAheadQueue::receive(std::vector<uint8_t> *samples)
+{
+    if (m_items.empty()) {
+        samples->resize(0);
+        return 0;
+    }
+    std::shared_ptr<Item> item = m_items.front();
+    m_items.pop_front();
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!item->done)
+            m_cond.wait(lock);
+    }
+    if (item->error)
+        std::rethrow_exception(item->error);
+    samples->swap(item->samples);
+    return item->nsamples;
+}
+
+/*
+ * Packets being decoded right now are left to finish on their own;
+ * nobody waits for the result any more.
+ */
+void DecodeAheadQueue::reset()
+{
+    m_items.clear();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.clear();
+}
+
+void DecodeAheadQueue::run(std::shared_ptr<IPacketDecoder> decoder)
+{
+    for (;;) {
+        std::shared_ptr<Item> item;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_quit && m_queue.empty())
+                m_cond.wait(lock);
+            if (m_quit)
+                break;
+            item = m_queue.front();
+            m_queue.pop_front();
+        }
+        Log::instance().set_thread_buffer(item->log);
+        try {
+            item->nsamples = decoder->decode(item->packet, &item->samples);
+        } catch (...) {
+            item->error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            item->done = true;
+        }
+        m_cond.notify_all();
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef DECODEAHEADQUEUE_H
+#define DECODEAHEADQUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "PacketDecoder.h"
+#include "logging.h"
+
+/*
+ * Decodes packets on a pool of threads, each with its own decoder, and
+ * hands out the results in the order the packets were submitted.
+ * Only for codecs whose packets decode independently (ALAC).
+ */
+class DecodeAheadQueue {
+    struct Item {
+        std::vector<uint8_t> packet;
+        std::vector<uint8_t> samples;
+        size_t nsamples;
+        std::exception_ptr error;
+        std::shared_ptr<LogBuffer> log; /* of the thread that submitted it */
+        bool done;
+        Item(): nsamples(0), done(false) {}
+    };
+    std::vector<std::thread> m_workers;
+    std::deque<std::shared_ptr<Item>> m_items; /* in submission order */
+    std::deque<std::shared_ptr<Item>> m_queue; /* not yet taken */
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    size_t m_depth;
+    bool m_quit;
+public:
+    typedef std::function<std::shared_ptr<IPacketDecoder>()> DecoderFactory;
+
+    DecodeAheadQueue(const DecoderFactory &factory, unsigned nthreads);
+    ~DecodeAheadQueue();
+    /* number of packets worth keeping submitted */
+    size_t depth() const { return m_depth; }
+    size_t pending() const { return m_items.size(); }
+    /* takes the contents of packet */
+    void submit(std::vector<uint8_t> *packet);
+    /* waits for the oldest packet, same as IPacketDecoder::decode() */
+    size_t receive(std::vector<uint8_t> *samples);
+    /* drops every pending packet */
+    void reset();
+private:
+    void run(std::shared_ptr<IPacketDecoder> decoder);
+};
+
+#endif
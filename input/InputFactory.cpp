@@ -21,11 +21,31 @@
 std::shared_ptr<ISeekableSource> InputFactory::open(const std::string &path,
         std::shared_ptr<IInputStream> stream)
 {
+    std::lock_guard<std::mutex> lock(m_mutex);
     std::map<std::string, std::shared_ptr<ISeekableSource> >::iterator
         pos = m_sources.find(path);
     if (pos != m_sources.end())
         return pos->second;
+    return create(path, stream, true);
+}
+
+std::shared_ptr<ISeekableSource>
+InputFactory::reopen(const ISeekableSource *src)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<std::string, std::shared_ptr<ISeekableSource> >::iterator
+        pos = m_sources.begin();
+    for (; pos != m_sources.end(); ++pos)
+        if (pos->second.get() == src)
+            break;
+    if (pos == m_sources.end() || pos->first == "-")
+        return nullptr;
+    return create(pos->first, nullptr, false);
+}
 
+std::shared_ptr<ISeekableSource> InputFactory::create(const std::string &path,
+        std::shared_ptr<IInputStream> stream, bool cache)
+{
     const char *ext = strutil::file_extension(path);
     if (stream)
         stream->seek(0, SEEK_SET);
@@ -34,7 +54,7 @@ std::shared_ptr<ISeekableSource> InputFactory::open(const std::string &path,
     if (m_is_raw) {
         std::shared_ptr<RawSource> src =
             std::make_shared<RawSource>(stream, m_raw_format);
-        m_sources[path] = src;
+        if (cache) m_sources[path] = src;
         return src;
     }
 #ifdef _WIN32
@@ -47,7 +67,7 @@ std::shared_ptr<ISeekableSource> InputFactory::open(const std::string &path,
         try { \
             std::shared_ptr<type> src = \
                 std::make_shared<type>(__VA_ARGS__); \
-            m_sources[path] = src; \
+            if (cache) m_sources[path] = src; \
             return src; \
         } catch (...) { \
             stream->seek(0, SEEK_SET); \
@@ -55,8 +75,8 @@ std::shared_ptr<ISeekableSource> InputFactory::open(const std::string &path,
     } while (0)
 
     TRY_MAKE_SHARED(WaveSource, stream, m_ignore_length);
-    TRY_MAKE_SHARED(MMTISOBMFFSource, stream);
-    TRY_MAKE_SHARED(CAFSource, stream);
+    TRY_MAKE_SHARED(MMTISOBMFFSource, stream, m_decode_threads);
+    TRY_MAKE_SHARED(CAFSource, stream, m_decode_threads);
 #ifdef QAAC
     TRY_MAKE_SHARED(ExtAFSource, stream);
 #endif
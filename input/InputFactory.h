@@ -1,6 +1,7 @@
 #ifndef INPUTFACTORY_H
 #define INPUTFACTORY_H
 
+#include <mutex>
 #include "ISource.h"
 #include "IInputStream.h"
 
@@ -8,9 +9,13 @@ class InputFactory {
     ca::AudioStreamBasicDescription m_raw_format;
     bool m_is_raw;
     bool m_ignore_length;
+    unsigned m_decode_threads;
     std::map<std::string, std::shared_ptr<ISeekableSource> > m_sources;
+    std::mutex m_mutex;
 private:
-    InputFactory() : m_is_raw(false), m_ignore_length(false) {}
+    InputFactory()
+        : m_is_raw(false), m_ignore_length(false), m_decode_threads(0)
+    {}
     InputFactory(const InputFactory&);
     InputFactory& operator=(InputFactory&);
 public:
@@ -21,6 +26,12 @@ public:
     }
     std::shared_ptr<ISeekableSource> open(const std::string &path,
             std::shared_ptr<IInputStream> stream = nullptr);
+    /*
+     * Open another, independent instance of a source returned by open().
+     * Returns nullptr when it can't be done (source is not from open(),
+     * or is read from stdin).
+     */
+    std::shared_ptr<ISeekableSource> reopen(const ISeekableSource *src);
     void setRawFormat(const ca::AudioStreamBasicDescription &asbd)
     {
         m_raw_format = asbd;
@@ -30,10 +41,17 @@ public:
     {
         m_ignore_length = cond;
     }
+    void setDecodeThreads(unsigned n)
+    {
+        m_decode_threads = n;
+    }
     void close()
     {
         m_sources.clear();
     }
+private:
+    std::shared_ptr<ISeekableSource> create(const std::string &path,
+            std::shared_ptr<IInputStream> stream, bool cache);
 };
 
 #endif
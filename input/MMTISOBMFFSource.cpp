@@ -80,8 +80,10 @@ public:
     }
 };
 
-MMTISOBMFFSource::MMTISOBMFFSource(std::shared_ptr<IInputStream> stream)
-    : m_nextPacket(0)
+MMTISOBMFFSource::MMTISOBMFFSource(std::shared_ptr<IInputStream> stream,
+                                   unsigned decode_threads)
+    : m_decodeThreads(decode_threads)
+    , m_nextPacket(0)
     , m_position(0)
 {
     memset(&m_iasbd, 0, sizeof(m_iasbd));
@@ -121,6 +123,8 @@ MMTISOBMFFSource::MMTISOBMFFSource(std::shared_ptr<IInputStream> stream)
         throw std::runtime_error("unsupported codec");
     }
     m_decodeBuffer.set_unit(m_oasbd.mBytesPerFrame);
+    m_directDecoder = m_decodeAhead ? nullptr
+                    : dynamic_cast<IDirectPacketDecoder*>(m_decoder.get());
 
     if (!m_movieInfo.userData.empty()) {
         for (auto&& userData : m_movieInfo.userData) {
@@ -181,17 +185,38 @@ MMTISOBMFFSource::MMTISOBMFFSource(std::shared_ptr<IInputStream> stream)
     seekTo(0);
 }
 
+/*
+ * With nothing buffered and room for a whole packet, decode straight into
+ * the caller's buffer.
+ */
 size_t MMTISOBMFFSource::readSamples(void *buffer, size_t nsamples)
+{
+    if (m_directDecoder && m_decodeBuffer.count() == 0 &&
+        nsamples >= m_directDecoder->maxFramesPerPacket() &&
+        m_position < m_currentEditEndPosition) {
+        bool ok = readPacket(&m_packetBuffer);
+        int64_t n = m_directDecoder->decodeTo(m_packetBuffer, buffer);
+        n = std::min<int64_t>(n, m_currentEditEndPosition - m_position);
+        if (n > 0 || !ok) {
+            m_position += n;
+            return n;
+        }
+    }
+    const void *data;
+    nsamples = readBlock(&data, nsamples);
+    std::memcpy(buffer, data, nsamples * m_oasbd.mBytesPerFrame);
+    return nsamples;
+}
+
+size_t MMTISOBMFFSource::readBlock(const void **data, size_t nsamples)
 {
     if (m_decodeBuffer.count() == 0) {
         fillDecodeBuffer();
     }
     if (nsamples > m_decodeBuffer.count())
         nsamples = m_decodeBuffer.count();
-    if (nsamples > 0) {
-        std::memcpy(buffer, m_decodeBuffer.read(nsamples), nsamples * m_oasbd.mBytesPerFrame);
-        m_position += nsamples;
-    }
+    *data = m_decodeBuffer.read(nsamples);
+    m_position += nsamples;
     return nsamples;
 }
 
@@ -199,10 +224,14 @@ void MMTISOBMFFSource::seekTo(int64_t count)
 {
     if (count >= length()) {
         m_nextPacket = m_trackInfo.sampleCount;
+        if (m_decodeAhead)
+            m_decodeAhead->reset();
         return;
     }
     m_decodeBuffer.reset();
     m_decoder->reset();
+    if (m_decodeAhead)
+        m_decodeAhead->reset();
     int64_t offsetInEdit;
     m_currentEdit = m_edits.editForPosition(count, &offsetInEdit);
     int64_t offsetInMediaTime = m_edits.mediaOffset(m_currentEdit) + offsetInEdit;
@@ -250,20 +279,46 @@ void MMTISOBMFFSource::fillDecodeBuffer()
     while (m_decodeBuffer.count() == 0) {
         if (m_position + m_decodeBuffer.count() >= m_currentEditEndPosition)
             seekTo(m_position);
-        bool ok = readPacket(&m_packetBuffer);
-        int nsamples = m_decoder->decode(m_packetBuffer, &m_rawDecodeBuffer);
+        int nsamples;
+        bool ok = decodePacket(&nsamples);
         if (m_position + m_decodeBuffer.count() + nsamples > m_currentEditEndPosition) {
             nsamples = std::max<int64_t>(0LL, m_currentEditEndPosition - m_position - int(m_decodeBuffer.count()));
         }
         if (!ok && nsamples == 0) break;
-        if (nsamples > 0) {
-            m_decodeBuffer.reserve(nsamples);
-            std::memcpy(m_decodeBuffer.write_ptr(), m_rawDecodeBuffer.data(), m_rawDecodeBuffer.size());
+        if (nsamples > 0)
             m_decodeBuffer.commit(nsamples);
-        }
     }
 }
 
+/*
+ * Decode the next packet to the write end of m_decodeBuffer, through the
+ * decode-ahead queue if any, without committing it.
+ * Returns false at the end of the track.
+ */
+bool MMTISOBMFFSource::decodePacket(int *nsamples)
+{
+    if (m_directDecoder) {
+        bool ok = readPacket(&m_packetBuffer);
+        m_decodeBuffer.reserve(m_directDecoder->maxFramesPerPacket());
+        *nsamples = m_directDecoder->decodeTo(m_packetBuffer, m_decodeBuffer.write_ptr());
+        return ok;
+    }
+    bool ok;
+    if (m_decodeAhead) {
+        while (m_decodeAhead->pending() < m_decodeAhead->depth() &&
+               readPacket(&m_packetBuffer))
+            m_decodeAhead->submit(&m_packetBuffer);
+        ok = m_decodeAhead->pending() > 0;
+        *nsamples = m_decodeAhead->receive(&m_rawDecodeBuffer);
+    } else {
+        ok = readPacket(&m_packetBuffer);
+        *nsamples = m_decoder->decode(m_packetBuffer, &m_rawDecodeBuffer);
+    }
+    m_decodeBuffer.reserve(*nsamples);
+    std::memcpy(m_decodeBuffer.write_ptr(), m_rawDecodeBuffer.data(), *nsamples * m_oasbd.mBytesPerFrame);
+    return ok;
+}
+
 void MMTISOBMFFSource::setupALAC()
 {
     auto alac = m_trackReader->decoderConfigRecord();
@@ -294,13 +349,20 @@ void MMTISOBMFFSource::setupALAC()
         acl.mChannelLayoutTag = chanmap::getALACChannelLayoutTag(m_iasbd.mChannelsPerFrame);
         m_chanmap = chanmap::getChannels(&acl);
 	}
+    ca::AudioStreamBasicDescription asbd = m_iasbd;
+    auto createDecoder = [asbd, alac]() -> std::shared_ptr<IPacketDecoder> {
 #ifdef QAAC
-    m_decoder = std::make_shared<CoreAudioPacketDecoder>(cautil::toNative(m_iasbd));
+        auto decoder = std::make_shared<CoreAudioPacketDecoder>(cautil::toNative(asbd));
 #else
-    m_decoder = std::make_shared<ALACPacketDecoder>(m_iasbd);
+        auto decoder = std::make_shared<ALACPacketDecoder>(asbd);
 #endif
-    m_decoder->setMagicCookie(alac);
+        decoder->setMagicCookie(alac);
+        return decoder;
+    };
+    m_decoder = createDecoder();
     m_oasbd = m_decoder->getSampleFormat();
+    if (m_decodeThreads > 1)
+        m_decodeAhead = std::make_shared<DecodeAheadQueue>(createDecoder, m_decodeThreads);
 }
 
 void MMTISOBMFFSource::setupFLAC()
@@ -8,8 +8,10 @@
 #include "IInputStream.h"
 #include "util.h"
 #include "MP4Edits.h"
+#include "DecodeAheadQueue.h"
 
-class MMTISOBMFFSource: public ISeekableSource, public ITagParser, public IChapterParser
+class MMTISOBMFFSource: public ISeekableSource, public IBlockSource,
+    public ITagParser, public IChapterParser
 {
     std::unique_ptr<mmt::isobmff::CIsobmffReader> m_movieReader;
     std::unique_ptr<mmt::isobmff::CGenericAudioTrackReader> m_trackReader;
@@ -18,6 +20,9 @@ class MMTISOBMFFSource: public ISeekableSource, public ITagParser, public IChapt
     ca::AudioStreamBasicDescription m_iasbd, m_oasbd;
     std::vector<uint32_t> m_chanmap;
     std::shared_ptr<IPacketDecoder> m_decoder;
+    std::shared_ptr<DecodeAheadQueue> m_decodeAhead;
+    IDirectPacketDecoder *m_directDecoder;
+    unsigned m_decodeThreads;
     MP4Edits m_edits;
     std::vector<uint8_t> m_packetBuffer;
     std::vector<uint8_t> m_rawDecodeBuffer;
@@ -29,7 +34,11 @@ class MMTISOBMFFSource: public ISeekableSource, public ITagParser, public IChapt
     std::map<std::string, std::string> m_tags;
     std::vector<misc::chapter_t> m_chapters;
 public:
-    MMTISOBMFFSource(std::shared_ptr<IInputStream> stream);
+    /*
+     * decode_threads > 1 decodes ALAC packets ahead on that many threads.
+     */
+    MMTISOBMFFSource(std::shared_ptr<IInputStream> stream,
+                     unsigned decode_threads=0);
     uint64_t length() const
     {
         return m_edits.totalDuration();
@@ -44,11 +53,13 @@ public:
     }
     int64_t getPosition() { return m_position; }
     size_t readSamples(void *buffer, size_t nsamples);
+    size_t readBlock(const void **data, size_t nsamples);
     void seekTo(int64_t count);
     const std::map<std::string, std::string> &getTags() const { return m_tags; }
     const std::vector<misc::chapter_t> &getChapters() const { return m_chapters; }
 private:
     bool readPacket(std::vector<uint8_t>* buffer);
+    bool decodePacket(int *nsamples);
     int64_t mediaTimeToDecodeTime(int64_t mediaTime);
     int64_t decodeTimeToMediaTime(int64_t decodeTime);
     void fillDecodeBuffer();
@@ -14,4 +14,15 @@ struct IPacketDecoder {
     virtual size_t decode(const std::vector<uint8_t> &packet, std::vector<uint8_t> *samples) = 0;
 };
 
+/*
+ * Decoders that can write samples straight into the consumer's buffer.
+ * decodeTo() works like decode(), into room for maxFramesPerPacket()
+ * frames in getSampleFormat().
+ */
+struct IDirectPacketDecoder {
+    virtual ~IDirectPacketDecoder() {}
+    virtual size_t maxFramesPerPacket() const = 0;
+    virtual size_t decodeTo(const std::vector<uint8_t> &packet, void *buffer) = 0;
+};
+
 #endif
@@ -51,6 +51,26 @@ size_t RawSource::readSamples(void *buffer, size_t nsamples)
     return nsamples;
 }
 
+/*
+ * Only signed little endian input is packed already.
+ */
+bool RawSource::hasPackedSamples() const
+{
+    return (m_asbd.mFormatFlags & kAudioFormatFlagIsSignedInteger) &&
+           !(m_asbd.mFormatFlags & kAudioFormatFlagIsBigEndian) &&
+           m_asbd.mBitsPerChannel > 8 &&
+           m_asbd.mBytesPerFrame == (m_asbd.mBitsPerChannel + 7) / 8
+                                    * m_asbd.mChannelsPerFrame;
+}
+
+size_t RawSource::readPacked(void *buffer, size_t nsamples)
+{
+    ssize_t nbytes = m_stream->read(buffer, nsamples * m_asbd.mBytesPerFrame);
+    nsamples = nbytes > 0 ? nbytes / m_asbd.mBytesPerFrame : 0;
+    m_position += nsamples;
+    return nsamples;
+}
+
 void RawSource::seekTo(int64_t count)
 {
     CHECKCRT(m_stream->seek(count*m_asbd.mBytesPerFrame, SEEK_SET) < 0);
@@ -5,7 +5,7 @@
 #include "platformutil.h"
 #include "IInputStream.h"
 
-class RawSource: public ISeekableSource {
+class RawSource: public ISeekableSource, public IPackedSource {
     uint64_t m_length;
     int64_t m_position;
     std::shared_ptr<IInputStream> m_stream;
@@ -21,6 +21,8 @@ public:
     }
     const std::vector<uint32_t> *getChannels() const { return 0; }
     size_t readSamples(void *buffer, size_t nsamples);
+    bool hasPackedSamples() const;
+    size_t readPacked(void *buffer, size_t nsamples);
     void seekTo(int64_t count);
     int64_t getPosition() { return m_position; }
 };
@@ -39,15 +39,7 @@ WaveSource::WaveSource(std::shared_ptr<IInputStream> stream, bool ignorelength)
 
 size_t WaveSource::readSamples(void *buffer, size_t nsamples)
 {
-    if (m_length != ~0ULL) {
-        nsamples = static_cast<size_t>(std::min(static_cast<uint64_t>(nsamples),
-                                                m_length - m_position));
-    }
-    ssize_t nbytes = nsamples * m_block_align;
-    if (m_buffer.size() < nbytes)
-        m_buffer.resize(nbytes);
-    nbytes = m_stream->read(&m_buffer[0], nbytes);
-    nsamples = nbytes > 0 ? nbytes / m_block_align: 0;
+    nsamples = readRaw(nsamples);
     if (nsamples) {
         size_t size = nsamples * m_block_align;
         util::unpack(&m_buffer[0], buffer, &size,
@@ -58,10 +50,70 @@ size_t WaveSource::readSamples(void *buffer, size_t nsamples)
             util::convert_sign(static_cast<uint32_t *>(buffer),
                                nsamples * m_asbd.mChannelsPerFrame);
         }
-        m_position += nsamples;
     }
     return nsamples;
 }
+
+size_t WaveSource::readBlock(const void **data, size_t nsamples)
+{
+    if (static_cast<uint32_t>(m_block_align) != m_asbd.mBytesPerFrame) {
+        /* has to be widened anyway */
+        size_t nbytes = nsamples * m_asbd.mBytesPerFrame;
+        if (m_unpacked.size() < nbytes)
+            m_unpacked.resize(nbytes);
+        *data = m_unpacked.data();
+        return readSamples(m_unpacked.data(), nsamples);
+    }
+    nsamples = readRaw(nsamples);
+    *data = m_buffer.data();
+    return nsamples;
+}
+
+/*
+ * Packed samples are the data chunk as is, or narrowed from 32-bit
+ * containers with the valid bits at the top.
+ */
+bool WaveSource::hasPackedSamples() const
+{
+    unsigned width = m_block_align / m_asbd.mChannelsPerFrame;
+    return !(m_asbd.mFormatFlags & ca::kAudioFormatFlagIsFloat) &&
+           m_asbd.mBitsPerChannel > 8 &&
+           (width == (m_asbd.mBitsPerChannel + 7) / 8 || width == 4);
+}
+
+size_t WaveSource::readPacked(void *buffer, size_t nsamples)
+{
+    unsigned width = m_block_align / m_asbd.mChannelsPerFrame;
+    unsigned packed_width = (m_asbd.mBitsPerChannel + 7) / 8;
+    if (width == packed_width)
+        return readRaw(buffer, nsamples);
+    nsamples = readRaw(nsamples);
+    size_t size = nsamples * m_block_align;
+    util::pack(&m_buffer[0], &size, width, packed_width);
+    std::memcpy(buffer, &m_buffer[0], size);
+    return nsamples;
+}
+
+size_t WaveSource::readRaw(size_t nsamples)
+{
+    size_t nbytes = nsamples * m_block_align;
+    if (m_buffer.size() < nbytes)
+        m_buffer.resize(nbytes);
+    return readRaw(&m_buffer[0], nsamples);
+}
+
+size_t WaveSource::readRaw(void *buffer, size_t nsamples)
+{
+    if (m_length != ~0ULL) {
+        nsamples = static_cast<size_t>(std::min(static_cast<uint64_t>(nsamples),
+                                                m_length - m_position));
+    }
+    ssize_t nbytes = nsamples * m_block_align;
+    nbytes = m_stream->read(buffer, nbytes);
+    nsamples = nbytes > 0 ? nbytes / m_block_align: 0;
+    m_position += nsamples;
+    return nsamples;
+}
 void WaveSource::seekTo(int64_t count)
 {
 
@@ -17,7 +17,8 @@ namespace wave {
     extern const GUID ksFormatSubTypeFloat;
 }
 
-class WaveSource: public ISeekableSource {
+class WaveSource: public ISeekableSource, public IBlockSource,
+                  public IPackedSource {
     int m_block_align;
     int64_t m_data_pos;
     int64_t m_position;
@@ -25,6 +26,7 @@ class WaveSource: public ISeekableSource {
     std::shared_ptr<IInputStream> m_stream;
     std::vector<uint32_t> m_chanmap;
     std::vector<uint8_t> m_buffer;
+    std::vector<uint8_t> m_unpacked;
     ca::AudioStreamBasicDescription m_asbd;
 public:
     WaveSource(std::shared_ptr<IInputStream> m_stream, bool ignorelength = false);
@@ -39,8 +41,13 @@ public:
     }
     int64_t getPosition() { return m_position; }
     size_t readSamples(void *buffer, size_t nsamples);
+    size_t readBlock(const void **data, size_t nsamples);
+    bool hasPackedSamples() const;
+    size_t readPacked(void *buffer, size_t nsamples);
     void seekTo(int64_t count);
 private:
+    size_t readRaw(size_t nsamples);
+    size_t readRaw(void *buffer, size_t nsamples);
     int64_t parse();
     void read16le(void *n);
     void read32le(void *n);
@@ -1,10 +1,44 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
 #include <cstdio>
 #include <cstdarg>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 #include "platformutil.h"
 
+/*
+ * Messages of one job; the job's helper threads append to it as well.
+ */
+class LogBuffer {
+    std::string m_text;
+    std::mutex m_mutex;
+public:
+    void append(const char *s)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_text.append(s);
+    }
+    std::string str()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_text;
+    }
+};
+
 class Log {
     std::vector<std::shared_ptr<FILE>> m_streams;
+    std::mutex m_mutex;
+
+    static std::shared_ptr<LogBuffer> &thread_buffer()
+    {
+        static thread_local std::shared_ptr<LogBuffer> buffer;
+        return buffer;
+    }
 public:
     static Log &instance()
     {
@@ -45,11 +79,48 @@ public:
         vsnprintf(buffer.data(), buffer.size(), fmt, args2);
         va_end(args2);
 
+        std::shared_ptr<LogBuffer> capture = thread_buffer();
+        if (capture)
+            capture->append(buffer.data());
+        else
+            write(buffer.data());
+    }
+    /*
+     * While set, messages from the calling thread are appended to buf
+     * instead of being written out, so that output of a job running on
+     * a worker thread can later be emitted in one piece by write().
+     */
+    void set_thread_buffer(const std::shared_ptr<LogBuffer> &buf)
+    {
+        thread_buffer() = buf;
+    }
+    std::shared_ptr<LogBuffer> get_thread_buffer()
+    {
+        return thread_buffer();
+    }
+    /*
+     * std::thread whose messages go where the calling thread's go, for
+     * the helper threads of a job.
+     */
+    template <typename F, typename... Args>
+    static std::thread start_thread(F &&f, Args &&... args)
+    {
+        std::shared_ptr<LogBuffer> buf = thread_buffer();
+        std::function<void()> task =
+            std::bind(std::forward<F>(f), std::forward<Args>(args)...);
+        return std::thread([buf, task]() {
+            thread_buffer() = buf;
+            task();
+        });
+    }
+    void write(const std::string &message)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
 #ifdef _WIN32
-        OutputDebugStringA(buffer.data());
+        OutputDebugStringA(message.c_str());
 #endif
         for (size_t i = 0; i < m_streams.size(); ++i)
-            platform::write_utf8(m_streams[i].get(), buffer.data());
+            platform::write_utf8(m_streams[i].get(), message);
     }
     void printf(const char *fmt, ...)
     {
@@ -68,4 +139,6 @@ private:
 #define LOG(fmt, ...) Log::instance().printf(fmt, ##__VA_ARGS__)
 #else
 #define LOG(fmt, ...) Log::instance().printf(fmt, __VA_ARGS__)
-#endif
\ No newline at end of file
+#endif
+
+#endif
@@ -1,5 +1,8 @@
+#include <atomic>
 #include <chrono>
 #include <clocale>
+#include <condition_variable>
+#include <mutex>
 #include <numeric>
 #include <regex>
 #include <thread>
@@ -21,6 +24,7 @@
 #include "CAFSink.h"
 #include "SoundIoOutDevice.h"
 #include "PeakSink.h"
+#include "BitDepthSink.h"
 #include "MMTISOBMFFAACSink.h"
 #include "MMTISOBMFFALACSink.h"
 #include "cuesheet.h"
@@ -128,6 +132,63 @@ std::string errormsg(const std::exception &ex)
     return ex.what();
 }
 
+/*
+ * Aggregated progress of concurrently running jobs (--jobs).
+ * Progress instances on worker threads only add to the counters;
+ * the scheduler thread does all the console output.
+ */
+class BatchProgress {
+    PeriodicDisplay m_disp;
+    bool m_verbose;
+    size_t m_total;
+    std::atomic<size_t> m_done;
+    std::atomic<uint64_t> m_processed_ms;
+    size_t m_message_len;
+    platform::Timer m_timer;
+public:
+    BatchProgress(bool verbosity, size_t total)
+        : m_disp(100, verbosity), m_verbose(verbosity), m_total(total),
+          m_done(0), m_processed_ms(0), m_message_len(0)
+    {}
+    void add(double seconds)
+    {
+        m_processed_ms += static_cast<uint64_t>(seconds * 1000.0);
+    }
+    void job_done() { ++m_done; }
+    void update()
+    {
+        if (!m_verbose) return;
+        double seconds = m_processed_ms / 1000.0;
+        double ellapsed = m_timer.ellapsed();
+        double speed = ellapsed ? seconds/ellapsed : 0.0;
+        std::string msg =
+            strutil::format("\r[%u/%u files] %s processed (%.1fx)  ",
+                            static_cast<unsigned>(m_done.load()),
+                            static_cast<unsigned>(m_total),
+                            util::format_seconds(seconds).c_str(), speed);
+        m_message_len = msg.size();
+        m_disp.put(msg);
+    }
+    // erase the progress line so that log output can be written
+    void clear()
+    {
+        if (!m_verbose || !m_message_len) return;
+        std::string blank = "\r" + std::string(m_message_len, ' ') + "\r";
+        platform::write_utf8(stderr, blank);
+        m_message_len = 0;
+    }
+    void finish()
+    {
+        clear();
+        LOG("%u/%u files processed in %s\n",
+            static_cast<unsigned>(m_done.load()),
+            static_cast<unsigned>(m_total),
+            util::format_seconds(m_timer.ellapsed()).c_str());
+    }
+};
+
+static BatchProgress *g_batch_progress = 0;
+
 class Progress {
     PeriodicDisplay m_disp;
     bool m_verbose;
@@ -138,10 +199,13 @@ class Progress {
     bool m_console_visible;
     bool m_stderr_valid;
     bool m_show_eta;
+    bool m_scan;
+    uint64_t m_reported;
 public:
     Progress(bool verbosity, uint64_t total, uint32_t rate, bool showEta = true)
         : m_disp(100, verbosity), m_verbose(verbosity),
-          m_total(total), m_rate(rate), m_show_eta(showEta)
+          m_total(total), m_rate(rate), m_show_eta(showEta), m_scan(false),
+          m_reported(0)
     {
 #ifdef _WIN32
         m_stderr_valid =
@@ -154,8 +218,18 @@ public:
         if (total != ~0ULL)
             m_tstamp = util::format_seconds(static_cast<double>(total) / rate);
     }
+    /*
+     * A pass that only scans the input before the encode (--normalize,
+     * --alac-detect-depth). Not counted in the --jobs batch total, which
+     * would otherwise count those files twice.
+     */
+    void setScan() { m_scan = true; }
     void update(uint64_t current)
     {
+        if (g_batch_progress) {
+            report_to_batch(current);
+            return;
+        }
         if ((!m_verbose || !m_stderr_valid) && !m_console_visible) return;
         double fcurrent = current;
         double percent = 100.0 * fcurrent / m_total;
@@ -183,17 +257,30 @@ public:
     }
     void finish(uint64_t current)
     {
-        m_disp.flush();
-        if (m_verbose) fputc('\n', stderr);
+        if (g_batch_progress)
+            report_to_batch(current);
+        else {
+            m_disp.flush();
+            if (m_verbose) fputc('\n', stderr);
+        }
         double ellapsed = m_timer.ellapsed();
         LOG("%lld/%lld samples processed in %s\n",
             current, m_total, util::format_seconds(ellapsed).c_str());
     }
+private:
+    void report_to_batch(uint64_t current)
+    {
+        if (!m_scan && current > m_reported) {
+            g_batch_progress->add(double(current - m_reported) / m_rate);
+            m_reported = current;
+        }
+    }
 };
 
 static
 ca::AudioStreamBasicDescription get_encoding_ASBD(const ISource *src,
-                                                   uint32_t codecid)
+                                                   uint32_t codecid,
+                                                   uint32_t alac_frames)
 {
     ca::AudioStreamBasicDescription iasbd = src->getSampleFormat();
     ca::AudioStreamBasicDescription oasbd = { 0 };
@@ -207,7 +294,7 @@ ca::AudioStreamBasicDescription get_encoding_ASBD(const ISource *src,
     else if (codecid == 'aach')
         oasbd.mFramesPerPacket = 2048;
     else if (codecid == 'alac')
-        oasbd.mFramesPerPacket = 4096;
+        oasbd.mFramesPerPacket = alac_frames ? alac_frames : 4096;
 
     if (codecid == 'alac') {
         if (!(iasbd.mFormatFlags & kAudioFormatFlagIsSignedInteger))
@@ -357,6 +444,147 @@ std::string pcm_format_str(const ca::AudioStreamBasicDescription &asbd)
     return strutil::format("%s%d", stype[itype], asbd.mBitsPerChannel);
 }
 
+/*
+ * Feeds src from the current position to the end to one Sink per range,
+ * read by independent decoder instances on multiple threads. All of them
+ * stop early once a Sink is done(). prescan is true when an encode of
+ * src follows (see Progress::setScan()).
+ * Returns false when not applicable; src must be read serially then.
+ */
+template <typename Sink>
+static bool scan_parallel(ISeekableSource *src, const Options &opts,
+                          bool prescan,
+                          std::vector<std::shared_ptr<Sink> > *sinks)
+{
+    unsigned nthreads = std::thread::hardware_concurrency();
+    const ca::AudioStreamBasicDescription &sf = src->getSampleFormat();
+    if (nthreads < 2 || src->length() == ~0ULL ||
+        ((sf.mFormatFlags & kAudioFormatFlagIsFloat) &&
+         sf.mBitsPerChannel < 32))
+        return false;
+    int64_t start = src->getPosition();
+    uint64_t total = src->length() - start;
+    if (total < nthreads * sf.mSampleRate)
+        return false;
+
+    ISeekableSource *base = src;
+    uint64_t offset = start;
+    TrimmedSource *trimmed = dynamic_cast<TrimmedSource*>(src);
+    if (trimmed) {
+        base = trimmed->getSource().get();
+        offset += trimmed->getStart();
+    }
+    // src itself reads the first range
+    std::vector<std::shared_ptr<ISeekableSource> > ranges;
+    for (unsigned i = 1; i < nthreads; ++i) {
+        std::shared_ptr<ISeekableSource> s =
+            InputFactory::instance().reopen(base);
+        if (!s) return false;
+        uint64_t begin = total * i / nthreads;
+        uint64_t end = total * (i + 1) / nthreads;
+        ranges.push_back(std::make_shared<TrimmedSource>(s, offset + begin,
+                                                         end - begin));
+    }
+
+    std::atomic<uint64_t> done(0);
+    std::atomic<unsigned> finished(0);
+    std::atomic<bool> stop(false);
+    sinks->clear();
+    for (unsigned i = 0; i < nthreads; ++i)
+        sinks->push_back(std::make_shared<Sink>(sf));
+    std::vector<std::exception_ptr> errors(nthreads);
+    auto scan = [&](unsigned i, ISeekableSource *s, uint64_t count) {
+        try {
+            if (i > 0) s->seekTo(0);
+            Sink &sink = *sinks->at(i);
+            std::vector<uint8_t> buffer;
+            const void *data;
+            size_t n;
+            while (count > 0 && !g_interrupted && !stop &&
+                   (n = readSamplesView(s, &buffer, &data,
+                                        std::min<uint64_t>(count, 4096))) > 0) {
+                sink.writeSamples(data, n * sf.mBytesPerFrame, n);
+                count -= n;
+                done += n;
+                if (sink.done())
+                    stop = true;
+            }
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+        ++finished;
+    };
+    std::vector<std::thread> threads;
+    threads.push_back(Log::start_thread(scan, 0, src, total / nthreads));
+    for (unsigned i = 1; i < nthreads; ++i)
+        threads.push_back(Log::start_thread(scan, i, ranges[i - 1].get(),
+                                            ranges[i - 1]->length()));
+
+    Progress progress(opts.verbose, total, sf.mSampleRate);
+    if (prescan)
+        progress.setScan();
+    while (finished < nthreads) {
+        progress.update(done);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    for (size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+    progress.finish(done);
+    for (unsigned i = 0; i < nthreads; ++i)
+        if (errors[i])
+            std::rethrow_exception(errors[i]);
+    src->seekTo(start);
+    return true;
+}
+
+static bool scan_peak_parallel(ISeekableSource *src, const Options &opts,
+                               bool prescan, double *peak)
+{
+    std::vector<std::shared_ptr<PeakSink> > sinks;
+    if (!scan_parallel(src, opts, prescan, &sinks))
+        return false;
+    *peak = 0.0;
+    for (size_t i = 0; i < sinks.size(); ++i)
+        *peak = std::max(*peak, sinks[i]->peak());
+    return true;
+}
+
+/*
+ * Effective bit depth of integer src from the current position to the end.
+ * src is rewound afterwards.
+ * Stops as soon as some sample uses the full depth, so real 24-bit input
+ * costs next to nothing.
+ */
+static unsigned detect_bit_depth(ISeekableSource *src, const Options &opts)
+{
+    const ca::AudioStreamBasicDescription &sf = src->getSampleFormat();
+    unsigned bits = 0;
+
+    LOG("Scanning effective bit depth...\n");
+    std::vector<std::shared_ptr<BitDepthSink> > sinks;
+    if (scan_parallel(src, opts, true, &sinks)) {
+        for (size_t i = 0; i < sinks.size(); ++i)
+            bits = std::max(bits, sinks[i]->effectiveBits());
+    } else {
+        int64_t start = src->getPosition();
+        BitDepthSink sink(sf);
+        std::vector<uint8_t> buffer;
+        const void *data;
+        size_t n;
+        Progress progress(opts.verbose, src->length(), sf.mSampleRate);
+        progress.setScan();
+        while (!g_interrupted && !sink.done() &&
+               (n = readSamplesView(src, &buffer, &data, 4096)) > 0) {
+            sink.writeSamples(data, n * sf.mBytesPerFrame, n);
+            progress.update(src->getPosition());
+        }
+        progress.finish(src->getPosition());
+        src->seekTo(start);
+        bits = sink.effectiveBits();
+    }
+    return bits;
+}
+
 static double do_normalize(std::vector<std::shared_ptr<ISource> > &chain,
                            const Options &opts, bool seekable)
 {
@@ -365,27 +593,99 @@ static double do_normalize(std::vector<std::shared_ptr<ISource> > &chain,
     chain.push_back(std::shared_ptr<ISource>(normalizer));
 
     LOG("Scanning maximum peak...\n");
-    uint64_t n = 0, rc;
-    Progress progress(opts.verbose, src->length(),
-                      src->getSampleFormat().mSampleRate);
-    while (!g_interrupted && (rc = normalizer->process(4096)) > 0) {
-        n += rc;
-        progress.update(src->getPosition());
+    /*
+     * With no filter in front of the normalizer, the source itself can be
+     * scanned in parallel.
+     */
+    ISeekableSource *ss = dynamic_cast<ISeekableSource*>(src.get());
+    double peak;
+    if (seekable && ss && scan_peak_parallel(ss, opts, true, &peak)) {
+        normalizer->setPeak(peak, ss->length() - ss->getPosition());
+    } else {
+        uint64_t rc;
+        Progress progress(opts.verbose, src->length(),
+                          src->getSampleFormat().mSampleRate);
+        progress.setScan();
+        while (!g_interrupted && (rc = normalizer->process(4096)) > 0)
+            progress.update(src->getPosition());
+        progress.finish(src->getPosition());
     }
-    progress.finish(src->getPosition());
     LOG("Peak: %g (%gdB)\n", normalizer->getPeak(), util::scale_to_dB(normalizer->getPeak()));
 	return normalizer->getPeak();
 }
 
-void build_filter_chain_sub(std::shared_ptr<ISeekableSource> src,
-                            std::vector<std::shared_ptr<ISource> > &chain,
-                            const Options &opts, bool normalize_pass=false)
+/*
+ * Stages of the filter chain to be followed by a thread boundary.
+ * --pipeline auto is a heuristic, nothing is measured: stages present in
+ * the chain are picked by a fixed ranking of their typical cost
+ * (resampler, lowpass, mixer, DRC, decoder), as long as spare processors
+ * remain.
+ */
+static
+uint32_t pipeline_splits(const Options &opts, unsigned nprocessors,
+                         bool final_reader)
 {
-    unsigned nprocessors = std::thread::hardware_concurrency();
-    bool threading = opts.threading && nprocessors > 1;
+    if (opts.isWaveOut())
+        return 0; // playback seeks the source under the chain
+    uint32_t splits = opts.pipeline & ~Options::kSplitAuto;
+    if (!(opts.pipeline & Options::kSplitAuto))
+        return splits;
+
+    int budget = static_cast<int>(nprocessors) - 1 - final_reader;
+    struct { uint32_t stage; int nthreads; } candidates[] = {
+        { Options::kSplitResample, opts.rate != -1 },
+        { Options::kSplitLowpass,  opts.lowpass > 0 },
+        { Options::kSplitMix,      opts.remix_preset || opts.remix_file },
+        { Options::kSplitDRC,      static_cast<int>(opts.drc_params.size()) },
+        { Options::kSplitDecode,   1 }
+    };
+    for (size_t i = 0; i < util::sizeof_array(candidates); ++i) {
+        int n = candidates[i].nthreads;
+        if (n > 0 && n <= budget) {
+            splits |= candidates[i].stage;
+            budget -= n;
+        }
+    }
+    return splits;
+}
 
-    ca::AudioStreamBasicDescription sasbd = src->getSampleFormat();
+static
+void split_pipeline(std::vector<std::shared_ptr<ISource> > &chain,
+                    const char *stage, const Options &opts)
+{
+    chain.push_back(std::make_shared<PipedReader>(chain.back()));
+    if (opts.verbose > 1 || opts.logfilename)
+        LOG("Pipeline: new thread after %s\n", stage);
+}
+
+/*
+ * A PipedReader starts reading its source as soon as its thread runs, so
+ * the threads are started only once the chain is complete.
+ */
+static
+void start_pipeline(const std::vector<std::shared_ptr<ISource> > &chain)
+{
+    for (size_t i = 0; i < chain.size(); ++i) {
+        PipedReader *reader = dynamic_cast<PipedReader*>(chain[i].get());
+        if (reader)
+            reader->start();
+    }
+}
+
+/*
+ * Stages up to DRC, which run before the normalizer.
+ */
+static
+void build_filter_chain_head(std::vector<std::shared_ptr<ISource> > &chain,
+                             const Options &opts, uint32_t splits)
+{
+    ca::AudioStreamBasicDescription sasbd = chain.back()->getSampleFormat();
+    if (splits & Options::kSplitDecode)
+        split_pipeline(chain, "decoder", opts);
+    size_t nstages = chain.size();
     manipulate_channels(chain, opts);
+    if ((splits & Options::kSplitMix) && chain.size() > nstages)
+        split_pipeline(chain, "channel mixer", opts);
     // check if channel layout is available for codec
     if (opts.isAAC() || opts.isALAC())
         get_encoding_channel_layout(chain.back().get(), opts, nullptr);
@@ -396,6 +696,8 @@ void build_filter_chain_sub(std::shared_ptr<ISeekableSource> src,
         std::shared_ptr<SoxLowpassFilter>
             f(new SoxLowpassFilter(chain.back(), opts.lowpass));
         chain.push_back(f);
+        if (splits & Options::kSplitLowpass)
+            split_pipeline(chain, "lowpass filter", opts);
     }
     {
         double irate = chain.back()->getSampleFormat().mSampleRate;
@@ -443,6 +745,10 @@ void build_filter_chain_sub(std::shared_ptr<ISeekableSource> src,
             }
         }
     }
+    if ((splits & Options::kSplitResample) &&
+        chain.back()->getSampleFormat().mSampleRate != sasbd.mSampleRate)
+        split_pipeline(chain, "resampler", opts);
+
     for (size_t i = 0; i < opts.drc_params.size(); ++i) {
         const DRCParams &p = opts.drc_params[i];
         if (opts.verbose > 1 || opts.logfilename)
@@ -464,24 +770,117 @@ void build_filter_chain_sub(std::shared_ptr<ISeekableSource> src,
                                       p.m_release,
                                       stat_file));
         chain.push_back(compressor);
+        if (splits & Options::kSplitDRC)
+            split_pipeline(chain, "DRC", opts);
     }
+}
+
+/*
+ * Second pass of the normalizer for seekable input: instead of spooling the
+ * first pass to a temporary file, rewind the source and run the stages in
+ * front of the normalizer once more.  They are deterministic, so the peak
+ * found in the first pass holds.
+ */
+static
+void rewind_filter_chain(std::shared_ptr<ISeekableSource> src,
+                         std::vector<std::shared_ptr<ISource> > &chain,
+                         const Options &opts, uint32_t splits,
+                         size_t nbase, int64_t start)
+{
+    std::shared_ptr<ISource> last = chain.back();
+    Normalizer *normalizer = dynamic_cast<Normalizer*>(last.get());
+    normalizer->setSource(std::shared_ptr<ISource>());
+    chain.resize(nbase);
+    src->seekTo(start);
+
+    // don't repeat the messages of the first build
+    struct LogSuppressor {
+        std::shared_ptr<LogBuffer> saved;
+        LogSuppressor(): saved(Log::instance().get_thread_buffer())
+        {
+            Log::instance().set_thread_buffer(std::make_shared<LogBuffer>());
+        }
+        ~LogSuppressor() { Log::instance().set_thread_buffer(saved); }
+    };
+    {
+        LogSuppressor suppress;
+        build_filter_chain_head(chain, opts, splits);
+    }
+    normalizer->setSource(chain.back());
+    chain.push_back(last);
+}
+
+void build_filter_chain_sub(std::shared_ptr<ISeekableSource> src,
+                            std::vector<std::shared_ptr<ISource> > &chain,
+                            const Options &opts, bool normalize_pass=false,
+                            bool seekable=false)
+{
+    unsigned nprocessors = std::thread::hardware_concurrency();
+    bool threading = opts.threading && nprocessors > 1;
+    uint32_t splits =
+        pipeline_splits(opts, nprocessors,
+                        threading && (opts.isAAC() || opts.isALAC()));
+
+    ca::AudioStreamBasicDescription sasbd = src->getSampleFormat();
+    size_t nbase = chain.size();
+    int64_t start = src->getPosition();
+    build_filter_chain_head(chain, opts, splits);
     if (normalize_pass) {
-        do_normalize(chain, opts, false);
+        start_pipeline(chain);
+        do_normalize(chain, opts, seekable);
+        if (seekable)
+            rewind_filter_chain(src, chain, opts, splits, nbase, start);
     }
 
+    /*
+     * Gain is point-wise, so it is folded into the Limiter or Quantizer
+     * that follows, and applied in the same pass over the samples.
+     * Scaler is only used when there is nothing to fold into.
+     */
+    double scale = 1.0;
     if (opts.gain) {
-        double scale = util::dB_to_scale(opts.gain);
+        scale = util::dB_to_scale(opts.gain);
         if (opts.verbose > 1 || opts.logfilename)
             LOG("Gain adjustment: %gdB, scale factor %g\n",
                 opts.gain, scale);
-        std::shared_ptr<ISource> scaler(new Scaler(chain.back(), scale));
-        chain.push_back(scaler);
     }
     if (opts.limiter) {
         if (opts.verbose > 1 || opts.logfilename)
             LOG("Limiter on\n");
-        std::shared_ptr<ISource> limiter(new Limiter(chain.back()));
+        std::shared_ptr<ISource> limiter(new Limiter(chain.back(), scale));
         chain.push_back(limiter);
+        scale = 1.0;
+    }
+    if (opts.alac_detect_depth && opts.isALAC() && !opts.bits_per_sample) {
+        /*
+         * The scan reads src directly, so only channel reordering may sit
+         * in between. Pipeline stages only pass samples through, and their
+         * threads are not started until the chain is complete.
+         */
+        bool direct = true;
+        for (size_t i = nbase; i < chain.size(); ++i)
+            if (!dynamic_cast<ChannelMapper*>(chain[i].get()) &&
+                !dynamic_cast<PipedReader*>(chain[i].get()))
+                direct = false;
+        ca::AudioStreamBasicDescription sfmt = chain.back()->getSampleFormat();
+        bool is_int = sfmt.mFormatFlags & kAudioFormatFlagIsSignedInteger;
+        if (!direct || !is_int || !seekable || scale != 1.0)
+            LOG("WARNING: --alac-detect-depth needs seekable integer input "
+                "without processing, ignored\n");
+        else if (sfmt.mBitsPerChannel > 16) {
+            unsigned bits = detect_bit_depth(src.get(), opts);
+            // round up to a depth that ALAC supports
+            unsigned abits = bits <= 16 ? 16 : bits <= 20 ? 20
+                           : bits <= 24 ? 24 : 32;
+            if (abits < sfmt.mBitsPerChannel) {
+                // the dropped bits are all zero, so plain truncation is exact
+                chain.push_back(std::make_shared<Quantizer>(chain.back(),
+                                                            abits, true));
+                LOG("Effective bit depth: %u, encoding as %u bit\n",
+                    bits, abits);
+            } else if (opts.verbose > 1 || opts.logfilename)
+                LOG("Effective bit depth: %u\n", bits);
+        }
     }
     if (opts.bits_per_sample) {
         bool is_float = (opts.bits_per_sample == 32 && !opts.isALAC());
@@ -490,12 +889,13 @@ void build_filter_chain_sub(std::shared_ptr<ISeekableSource> src,
 
         if (opts.isAAC())
             LOG("WARNING: --bits-per-sample has no effect for AAC\n");
-        else if (sbits != opts.bits_per_sample ||
+        else if (sbits != opts.bits_per_sample || scale != 1.0 ||
                  !!(sflags & kAudioFormatFlagIsFloat) != is_float) {
             std::shared_ptr<ISource>
                 isrc(new Quantizer(chain.back(), opts.bits_per_sample,
-                                   opts.no_dither, is_float));
+                                   opts.no_dither, is_float, scale));
             chain.push_back(isrc);
+            scale = 1.0;
             if (opts.verbose > 1 || opts.logfilename)
                 LOG("Convert to %d bit\n", opts.bits_per_sample);
         }
@@ -503,17 +903,22 @@ void build_filter_chain_sub(std::shared_ptr<ISeekableSource> src,
     if (opts.isAAC()) {
         ca::AudioStreamBasicDescription sfmt = chain.back()->getSampleFormat();
         if (!(sfmt.mFormatFlags & kAudioFormatFlagIsFloat) ||
-            sfmt.mBitsPerChannel != 32)
+            sfmt.mBitsPerChannel != 32 || scale != 1.0) {
             chain.push_back(std::make_shared<Quantizer>(chain.back(), 32,
-                                                        false, true));
+                                                        false, true, scale));
+            scale = 1.0;
+        }
+    }
+    if (scale != 1.0) {
+        std::shared_ptr<ISource> scaler(new Scaler(chain.back(), scale));
+        chain.push_back(scaler);
     }
     if (threading && (opts.isAAC() || opts.isALAC())) {
-        PipedReader *reader = new PipedReader(chain.back());
-        reader->start();
-        chain.push_back(std::shared_ptr<ISource>(reader));
+        chain.push_back(std::make_shared<PipedReader>(chain.back()));
         if (opts.verbose > 1 || opts.logfilename)
             LOG("Enable threading\n");
     }
+    start_pipeline(chain);
     if (opts.verbose > 1) {
         auto asbd = chain.back()->getSampleFormat();
         LOG("Format: %s -> %s\n",
@@ -523,10 +928,10 @@ void build_filter_chain_sub(std::shared_ptr<ISeekableSource> src,
 
 void build_filter_chain(std::shared_ptr<ISeekableSource> src,
                         std::vector<std::shared_ptr<ISource> > &chain,
-                        const Options &opts)
+                        const Options &opts, bool seekable=true)
 {
     chain.push_back(src);
-    build_filter_chain_sub(src, chain, opts, opts.normalize);
+    build_filter_chain_sub(src, chain, opts, opts.normalize, seekable);
 }
 
 static
@@ -687,10 +1092,12 @@ void decode_file(const std::vector<std::shared_ptr<ISource> > &chain,
     std::vector<uint8_t> buffer(4096 * bpf);
     try {
         size_t nread;
+        const void *data;
         while (!g_interrupted &&
-               (nread = src->readSamples(&buffer[0], 4096)) > 0) {
+               (nread = readSamplesView(src.get(), &buffer, &data, 4096)) > 0)
+        {
             progress.update(src->getPosition());
-            sink->writeSamples(&buffer[0], nread * bpf, nread);
+            sink->writeSamples(data, nread * bpf, nread);
         }
         progress.finish(src->getPosition());
     } catch (const std::exception &e) {
@@ -808,7 +1215,8 @@ ca::AudioStreamBasicDescription prepare_encode_target(
 {
     *channel_layout = map_to_aac_channels(chain, opts);
     *iasbd = chain.back()->getSampleFormat();
-    return get_encoding_ASBD(chain.back().get(), opts.output_format);
+    return get_encoding_ASBD(chain.back().get(), opts.output_format,
+                             opts.alac_frames);
 }
 
 static
@@ -1048,8 +1456,19 @@ void encode_file(std::vector<std::shared_ptr<ISource> > &chain,
     ca::AudioStreamBasicDescription iasbd;
     ca::AudioStreamBasicDescription oasbd =
         prepare_encode_target(chain, opts, &channel_layout, &iasbd);
-    ALACEncoderX encoder(iasbd);
-    encoder.setFastMode(opts.alac_fast);
+    ALACEncoderX encoder(iasbd, oasbd.mFramesPerPacket);
+    encoder.setLevel(opts.alac_level);
+    if (opts.alac_threads)
+        encoder.setNumThreads(opts.alac_threads);
+    else if (opts.alac_element_threads)
+        encoder.setElementThreads(opts.alac_element_threads);
+    else {
+        /* share the CPUs with the other --jobs */
+        unsigned ncpus = std::max(std::thread::hardware_concurrency(), 1U);
+        unsigned njobs = opts.jobs ? opts.jobs : ncpus;
+        encoder.setElementThreads(std::max(ncpus / njobs, 1U));
+    }
+    encoder.setVerify(opts.verify);
     auto cookie = encoder.getMagicCookie();
 
     platform::MakeSureDirectoryPathExistsX(ofilename);
@@ -1063,18 +1482,39 @@ void encode_file(std::vector<std::shared_ptr<ISource> > &chain,
     encoder.setSink(sink);
     set_tags(chain[0].get(), sink.get(), opts, "Apple Lossless Encoder");
 
+    auto start = std::chrono::steady_clock::now();
     run_encode(&encoder, sink, ofilename, opts);
+    if (opts.verbose > 1 || opts.logfilename) {
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        double duration = encoder.samplesRead() / iasbd.mSampleRate;
+        double pcm_kbps = iasbd.mSampleRate * iasbd.mChannelsPerFrame
+                        * iasbd.mBitsPerChannel / 1000.0;
+        LOG("ALAC level %d: ratio %.2f%%, %.1fx realtime\n",
+            encoder.level(), 100.0 * encoder.overallBitrate() / pcm_kbps,
+            duration / std::max(elapsed.count(), 1e-6));
+    }
+    if (opts.verify)
+        LOG("Verified %llu packets\n",
+            static_cast<unsigned long long>(encoder.packetsVerified()));
     finish_encode(&encoder, sink, ca::AudioFilePacketTableInfo(), opts);
 }
 #endif
 
 static
 void process_file(const std::shared_ptr<ISeekableSource> &src,
-                  const std::string &ofilename, const Options &opts)
+                  const std::string &ofilename, const Options &opts,
+                  bool seekable)
 {
     std::vector<std::shared_ptr<ISource> > chain;
-    build_filter_chain(src, chain, opts);
+    build_filter_chain(src, chain, opts, seekable);
 
+    double peak;
+    if (opts.isPeak() && seekable && chain.size() == 1 &&
+        scan_peak_parallel(src.get(), opts, false, &peak)) {
+        LOG("Peak: %g (%gdB)\n", peak, util::scale_to_dB(peak));
+        return;
+    }
     if (opts.isLPCM() || opts.isPeak())
         decode_file(chain, ofilename, opts);
     else
@@ -1291,6 +1731,14 @@ typedef std::pair<std::string, std::shared_ptr<ISeekableSource>> workItem;
 struct EncodeJob {
     std::shared_ptr<ISeekableSource> src;
     std::string ofilename;
+    /*
+     * Index of the command line argument the job came from.
+     * Tracks of a cuesheet or a chained Ogg file share the underlying
+     * source, therefore they must not be processed concurrently.
+     */
+    size_t group;
+    /* false when read from a pipe, which can't be rewound */
+    bool seekable;
 };
 
 static
@@ -1581,6 +2029,127 @@ void play_jobs(std::vector<EncodeJob> &jobs, const Options &opts)
         SoundIoOutDevice::instance().drain();
 }
 
+static
+void encode_job(const EncodeJob &job, const Options &opts)
+{
+    LOG("\n%s\n",
+        job.ofilename == "-" ? "<stdout>" : strutil::basename(job.ofilename));
+    job.src->seekTo(0);
+    process_file(job.src, job.ofilename, opts, job.seekable);
+}
+
+static
+void run_jobs_parallel(std::vector<EncodeJob> &jobs, const Options &opts,
+                       unsigned nthreads)
+{
+    struct JobState {
+        std::shared_ptr<LogBuffer> log;
+        std::exception_ptr error;
+        bool done;
+        JobState(): log(std::make_shared<LogBuffer>()), done(false) {}
+    };
+    std::vector<JobState> states(jobs.size());
+    std::vector<std::vector<size_t> > groups;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        if (i == 0 || jobs[i].group != jobs[i - 1].group)
+            groups.push_back(std::vector<size_t>());
+        groups.back().push_back(i);
+    }
+    nthreads = std::min(nthreads, static_cast<unsigned>(groups.size()));
+    LOG("Processing %u files at a time\n", nthreads);
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t next_group = 0;
+    unsigned running = nthreads;
+    bool failed = false;
+
+    BatchProgress progress(opts.verbose, jobs.size());
+    g_batch_progress = &progress;
+
+    auto worker = [&]() {
+        for (;;) {
+            size_t g;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (failed || g_interrupted || next_group == groups.size())
+                    break;
+                g = next_group++;
+            }
+            for (size_t k = 0; k < groups[g].size(); ++k) {
+                size_t i = groups[g][k];
+                JobState &state = states[i];
+                Log::instance().set_thread_buffer(state.log);
+                try {
+                    encode_job(jobs[i], opts);
+                } catch (...) {
+                    state.error = std::current_exception();
+                }
+                Log::instance().set_thread_buffer(nullptr);
+                progress.job_done();
+                std::lock_guard<std::mutex> lock(mutex);
+                state.done = true;
+                if (state.error) failed = true;
+                cond.notify_all();
+                if (failed || g_interrupted)
+                    break;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        --running;
+        cond.notify_all();
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < nthreads; ++i)
+        workers.push_back(std::thread(worker));
+
+    // emit buffered messages of each job in input order as they complete
+    size_t emitted = 0;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            for (; emitted < jobs.size() && states[emitted].done; ++emitted) {
+                progress.clear();
+                Log::instance().write(states[emitted].log->str());
+            }
+            if (!running) break;
+            cond.wait_for(lock, std::chrono::milliseconds(100));
+            progress.update();
+        }
+    }
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+    g_batch_progress = 0;
+
+    // on failure, jobs past the failed one may have completed out of order
+    std::exception_ptr error;
+    for (size_t i = emitted; i < jobs.size(); ++i) {
+        if (states[i].done)
+            Log::instance().write(states[i].log->str());
+    }
+    for (size_t i = 0; i < jobs.size() && !error; ++i)
+        error = states[i].error;
+    progress.finish();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+static
+void run_jobs(std::vector<EncodeJob> &jobs, const Options &opts)
+{
+    unsigned nthreads = opts.jobs;
+    if (!nthreads)
+        nthreads = std::max(std::thread::hardware_concurrency(), 1U);
+    // jobs are grouped in ascending order; see EncodeJob::group
+    if (nthreads > 1 && jobs.size() > 1 &&
+        jobs.front().group != jobs.back().group) {
+        run_jobs_parallel(jobs, opts, nthreads);
+        return;
+    }
+    for (size_t i = 0; i < jobs.size() && !g_interrupted; ++i)
+        encode_job(jobs[i], opts);
+}
+
 static int app_main(int argc, char **argv)
 {
     Options opts;
@@ -1713,6 +2282,10 @@ static int app_main(int argc, char **argv)
             InputFactory::instance().setRawFormat(getRawFormat(opts));
         }
         InputFactory::instance().setIgnoreLength(opts.ignore_length);
+        InputFactory::instance().setDecodeThreads(
+            opts.decode_threads ? opts.decode_threads
+                                : std::max(std::thread::hardware_concurrency(),
+                                           1U));
 
         struct CleanupScope {
             ~CleanupScope() {
@@ -1722,34 +2295,40 @@ static int app_main(int argc, char **argv)
         } __cleanup__;
 
         std::vector<workItem> workItems;
-        for (int i = 0; i < argc; ++i)
+        std::vector<size_t> itemGroups;
+        for (int i = 0; i < argc; ++i) {
             load_track(argv[i], opts, workItems);
+            itemGroups.resize(workItems.size(), i);
+        }
+        bool stdin_seekable = platform::is_seekable(0);
+        auto is_seekable_arg = [&](size_t i) {
+            return std::strcmp(argv[i], "-") || stdin_seekable;
+        };
 
         std::vector<EncodeJob> jobs;
         if (!opts.concat) {
             jobs.reserve(workItems.size());
             for (size_t i = 0; i < workItems.size(); ++i)
                 jobs.push_back({ trim_input(workItems[i].second, opts),
-                                 get_output_filename(workItems[i].first, opts) });
+                                 get_output_filename(workItems[i].first, opts),
+                                 itemGroups[i],
+                                 is_seekable_arg(itemGroups[i]) });
         } else {
             auto cs = std::make_shared<CompositeSource>();
-            for (size_t i = 0; i < workItems.size(); ++i)
+            bool seekable = true;
+            for (size_t i = 0; i < workItems.size(); ++i) {
                 cs->addSourceWithChapter(workItems[i].second, "");
+                seekable = seekable && is_seekable_arg(itemGroups[i]);
+            }
             jobs.push_back({ trim_input(cs, opts),
-                             get_output_filename(argv[0], opts) });
+                             get_output_filename(argv[0], opts), 0,
+                             seekable });
         }
 
         if (opts.isWaveOut()) {
             play_jobs(jobs, opts);
         } else {
-            for (ssize_t i = 0; i < (ssize_t)jobs.size() && !g_interrupted; ++i) {
-                const EncodeJob &job = jobs[i];
-                LOG("\n%s\n",
-                    job.ofilename == "-" ? "<stdout>"
-                                         : strutil::basename(job.ofilename));
-                job.src->seekTo(0);
-                process_file(job.src, job.ofilename, opts);
-            }
+            run_jobs(jobs, opts);
         }
     } catch (const std::exception &e) {
         LOG("ERROR: %s\n", errormsg(e).c_str());
@@ -24,6 +24,13 @@ static struct option long_options[] = {
 #endif
 #ifdef REFALAC
     { "fast", no_argument, 0, 'afst' },
+    { "fast-search", no_argument, 0, 'afse' },
+    { "alac-level", required_argument, 0, 'alvl' },
+    { "frames-per-packet", required_argument, 0, 'afpp' },
+    { "alac-threads", required_argument, 0, 'athr' },
+    { "alac-element-threads", required_argument, 0, 'aeth' },
+    { "verify", no_argument, 0, 'vrfy' },
+    { "alac-detect-depth", no_argument, 0, 'adep' },
 #endif
     { "check", no_argument, 0, 'chck' },
     { "alac", no_argument, 0, 'A' },
@@ -56,6 +63,9 @@ static struct option long_options[] = {
     { "verbose", no_argument, 0, 'verb' },
     { "stat", no_argument, 0, 'S' },
     { "threading", no_argument, 0, 'thrd' },
+    { "jobs", required_argument, 0, 'jobs' },
+    { "decode-threads", required_argument, 0, 'dthr' },
+    { "pipeline", required_argument, 0, 'pipe' },
     { "nice", no_argument, 0, 'n' },
     { "sort-args", no_argument, 0, 'soar' },
     { "tmpdir", required_argument, 0, 'tmpd' },
@@ -155,7 +165,46 @@ void usage()
 "                       iTunes only when this option is set.\n"
 #endif
 #ifdef REFALAC
-"--fast                 Fast stereo encoding mode.\n"
+"--alac-level <n>       Compression level, 0-4 (default 2). Higher levels\n"
+"                       search more encoding parameters at the cost of\n"
+"                       encoding speed. Files usually get smaller, but\n"
+"                       not always, since the encoder adapts as it goes:\n"
+"                       0: no search, same as --fast\n"
+"                       1: estimated costs, same as --fast-search\n"
+"                       2: reference encoder\n"
+"                       3: + predictor orders up to 16, denshift, pbFactor\n"
+"                       4: + finer stereo mixing, every even order\n"
+"--frames-per-packet <n>\n"
+"                       ALAC frames per packet, 32-65536 (default 4096).\n"
+"                       Smaller packets are written out sooner, larger\n"
+"                       ones have less header overhead. Players may not\n"
+"                       support sizes other than 4096.\n"
+"--fast                 Fast stereo encoding mode (--alac-level 0).\n"
+"--fast-search          Estimate the size of candidate predictors and mixes\n"
+"                       instead of trial encoding them. Faster than default,\n"
+"                       compresses nearly as well (--alac-level 1).\n"
+"--alac-threads <n>     Encode on n threads (default 0: no threads).\n"
+"                       Input is encoded in independent segments of\n"
+"                       256 packets (about 24s of 44.1kHz audio in\n"
+"                       4096-frame packets). Output is the same for\n"
+"                       any n > 0, but is not\n"
+"                       byte-identical to the default encode: it is\n"
+"                       slightly (about 0.05%) larger. Input shorter\n"
+"                       than one segment gives identical output.\n"
+"--alac-element-threads <n>\n"
+"                       Encode the channel elements of multichannel\n"
+"                       input on up to n threads. Result is the same as\n"
+"                       single threaded encoding. Default is the number\n"
+"                       of CPUs divided by --jobs, 1 disables it. Not\n"
+"                       used with --alac-threads.\n"
+"--verify               Decode every packet again while encoding, and\n"
+"                       fail if the result differs from the input.\n"
+"--alac-detect-depth    Scan the input first, and encode it at a lower\n"
+"                       bit depth when the low bits of every sample are\n"
+"                       zero (e.g. 16-bit audio in a 24-bit file). The\n"
+"                       result decodes to the same values, in the lower\n"
+"                       depth. Only for seekable integer input without\n"
+"                       other processing.\n"
 #endif
 "-d <dirname>           Output directory. Default is current working dir.\n"
 "--check                Show library versions and exit.\n"
@@ -244,6 +293,21 @@ void usage()
 "--verbose              More verbose console messages.\n"
 "-i, --ignorelength     Assume WAV input and ignore the data chunk length.\n"
 "--threading            Enable multi-threading.\n"
+"--pipeline <auto|stage[,stage...]>\n"
+"                       Run filter stages on separate threads, connected\n"
+"                       by bounded queues. Implies --threading.\n"
+"                       Stages: decode, mix, lowpass, resample, drc.\n"
+"                       Thread boundary is put after each given stage.\n"
+"                       \"auto\" picks stages present by a fixed ranking\n"
+"                       of their typical cost (nothing is measured), as\n"
+"                       many as the number of processors permits.\n"
+"--jobs <n>             Process up to n input files concurrently.\n"
+"                       0 means the number of available processors.\n"
+"                       Messages of each file are printed in input order\n"
+"                       when it is done; progress is shown as a total.\n"
+"--decode-threads <n>   Decode ALAC input (M4A/CAF) ahead on n threads.\n"
+"                       0 means the number of available processors.\n"
+"                       Default is 1 (decode on the reading thread).\n"
 "-n, --nice             Give lower process priority.\n"
 "--sort-args            Sort filenames given by command line arguments.\n"
 "--text-codepage <n>    Specify text code page of cuesheet/chapter/lyrics.\n"
@@ -501,6 +565,40 @@ bool Options::parse(int &argc, char **&argv)
             this->nice = true;
         else if (ch == 'thrd')
             this->threading = true;
+        else if (ch == 'pipe') {
+            static const char * const stages[] = {
+                "decode", "mix", "lowpass", "resample", "drc"
+            };
+            strutil::Tokenizer<char> tokens(optarg, ",");
+            char *tok;
+            while ((tok = tokens.next()) != 0) {
+                if (!std::strcmp(tok, "auto")) {
+                    this->pipeline |= kSplitAuto;
+                    continue;
+                }
+                size_t i = 0;
+                for (; i < util::sizeof_array(stages); ++i)
+                    if (!std::strcmp(tok, stages[i])) break;
+                if (i == util::sizeof_array(stages)) {
+                    complain("Invalid arg for --pipeline.\n");
+                    return false;
+                }
+                this->pipeline |= (1 << i);
+            }
+            this->threading = true;
+        }
+        else if (ch == 'jobs') {
+            if (std::sscanf(optarg, "%u", &this->jobs) != 1) {
+                complain("--jobs requires an integer.\n");
+                return false;
+            }
+        }
+        else if (ch == 'dthr') {
+            if (std::sscanf(optarg, "%u", &this->decode_threads) != 1) {
+                complain("--decode-threads requires an integer.\n");
+                return false;
+            }
+        }
         else if (ch == 'i')
             this->ignore_length = true;
         else if (ch == 'R')
@@ -606,7 +704,40 @@ bool Options::parse(int &argc, char **&argv)
         else if (ch == 'Rfmt')
             this->raw_format = optarg;
         else if (ch == 'afst')
-            this->alac_fast = true;
+            this->alac_level = 0;
+        else if (ch == 'afse')
+            this->alac_level = 1;
+        else if (ch == 'alvl') {
+            if (std::sscanf(optarg, "%u", &this->alac_level) != 1 ||
+                this->alac_level > 4) {
+                complain("--alac-level requires an integer from 0 to 4.\n");
+                return false;
+            }
+        }
+        else if (ch == 'afpp') {
+            if (std::sscanf(optarg, "%u", &this->alac_frames) != 1 ||
+                this->alac_frames < 32 || this->alac_frames > 65536) {
+                complain("--frames-per-packet requires an integer from "
+                         "32 to 65536.\n");
+                return false;
+            }
+        }
+        else if (ch == 'aeth') {
+            if (std::sscanf(optarg, "%u", &this->alac_element_threads) != 1) {
+                complain("--alac-element-threads requires an integer.\n");
+                return false;
+            }
+        }
+        else if (ch == 'vrfy')
+            this->verify = true;
+        else if (ch == 'adep')
+            this->alac_detect_depth = true;
+        else if (ch == 'athr') {
+            if (std::sscanf(optarg, "%u", &this->alac_threads) != 1) {
+                complain("--alac-threads requires an integer.\n");
+                return false;
+            }
+        }
         else if (ch == 'gain') {
             if (std::sscanf(optarg, "%lf", &this->gain) != 1) {
                 complain("--gain requires an floating point number.\n");
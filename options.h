@@ -27,6 +27,15 @@ struct Options {
 
 //    enum { kABR, kTVBR, kCVBR, kCBR };
     enum { kCBR, kABR, kCVBR, kTVBR };
+    /* --pipeline: stages to be followed by a thread boundary */
+    enum {
+        kSplitDecode   = 1,
+        kSplitMix      = 2,
+        kSplitLowpass  = 4,
+        kSplitResample = 8,
+        kSplitDRC      = 16,
+        kSplitAuto     = 0x80000000
+    };
 
     Options() :
         method(-1), quality(-1),
@@ -36,7 +45,8 @@ struct Options {
 
         bits_per_sample(0), raw_channels(2), raw_sample_rate(44100),
         artwork_size(0), native_resampler_complexity(0), textcp(0),
-        gapless_mode(0),
+        gapless_mode(0), jobs(1), decode_threads(1), alac_threads(0),
+        alac_element_threads(0), alac_level(2), alac_frames(0), pipeline(0),
 
         ofilename(0), outdir(0), raw_format("S16LE"),
         fname_format("${tracknumber}${title& }${title}"),
@@ -47,10 +57,11 @@ struct Options {
         save_stat(false), nice(false), native_chanmapper(false),
         ignore_length(false), no_optimize(false), native_resampler(false),
         check_only(false), normalize(false),
-        print_available_formats(false), alac_fast(false), threading(false),
+        print_available_formats(false), threading(false),
         concat(false), no_matrix_normalize(false), no_dither(false),
         filename_from_tag(false), sort_args(false),
         no_smart_padding(false), limiter(false), copy_artwork(false),
+        verify(false), alac_detect_depth(false),
 
         bitrate(-1.0), gain(0.0),
 
@@ -104,16 +115,17 @@ struct Options {
     unsigned num_priming;
     uint32_t bits_per_sample, raw_channels, raw_sample_rate,
              artwork_size, native_resampler_complexity, textcp,
-             gapless_mode;
+             gapless_mode, jobs, decode_threads, alac_threads,
+             alac_element_threads, alac_level, alac_frames, pipeline;
     const char
             *ofilename, *outdir, *raw_format, *fname_format, *chapter_file,
             *logfilename, *remix_preset, *remix_file, *tmpdir,
             *start, *end, *delay;
     bool is_raw, is_adts, is_caf, save_stat, nice, native_chanmapper,
          ignore_length, no_optimize, native_resampler, check_only,
-         normalize, print_available_formats, alac_fast, threading,
-         concat, no_matrix_normalize, no_dither, filename_from_tag,
-         sort_args, no_smart_padding, limiter, copy_artwork;
+         normalize, print_available_formats, threading, concat,
+         no_matrix_normalize, no_dither, filename_from_tag, sort_args,
+         no_smart_padding, limiter, copy_artwork, verify, alac_detect_depth;
     double bitrate, gain;
 
     uint32_t output_format;
@@ -0,0 +1,38 @@
+#ifndef BITDEPTHSINK_H
+#define BITDEPTHSINK_H
+
+#include "ISink.h"
+#include "cautil.h"
+#include "util.h"
+
+/*
+ * Finds the effective bit depth of integer samples: the number of bits
+ * above the lowest bit that is set in any sample.
+ */
+class BitDepthSink: public ISink {
+    uint32_t m_bits;
+    ca::AudioStreamBasicDescription m_asbd;
+public:
+    BitDepthSink(const ca::AudioStreamBasicDescription &asbd)
+        : m_bits(0), m_asbd(asbd)
+    {}
+    void writeSamples(const void *data, size_t, size_t nsamples)
+    {
+        m_bits |= util::or_reduce(static_cast<const uint32_t *>(data),
+                                  nsamples * m_asbd.mChannelsPerFrame);
+    }
+    /* no sample can lower the depth any more */
+    bool done() const
+    {
+        return effectiveBits() >= m_asbd.mBitsPerChannel;
+    }
+    unsigned effectiveBits() const
+    {
+        unsigned n = 32;
+        for (uint32_t bits = m_bits; n > 0 && !(bits & 1); bits >>= 1)
+            --n;
+        return n;
+    }
+};
+
+#endif
@@ -25,6 +25,7 @@ public:
         else
             process(static_cast<const double *>(data), nsamples);
     }
+    bool done() const { return false; }
     double peak() const
     {
         return m_peak / m_scale;
@@ -0,0 +1,650 @@
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include "simdutil.h"
+
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || \
+     defined(_M_IX86)) && (defined(__SSE2__) || defined(_M_X64))
+#define SIMDUTIL_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define SIMDUTIL_X86 0
+#endif
+
+#if SIMDUTIL_X86 && (defined(__GNUC__) || defined(__clang__))
+#define SIMDUTIL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMDUTIL_TARGET(isa)
+#endif
+
+namespace {
+    /*
+     * fast_log2(): x = m * 2^e with m in [sqrt(0.5), sqrt(2)), and
+     * log2(m) = 2/ln2 * atanh(t), t = (m-1)/(m+1), |t| < 0.172, summed
+     * up to t^9. fast_exp2(): y = n + f with |f| <= 0.5, and 2^f by its
+     * Taylor series up to f^7. The truncation errors (about 1e-9 and
+     * 1e-8) are below float rounding.
+     */
+    const float kSqrt2 = 1.41421356f;
+    const float kLog2A1 = 2.88539008f;
+    const float kLog2A3 = 0.961796694f;
+    const float kLog2A5 = 0.577078016f;
+    const float kLog2A7 = 0.412198583f;
+    const float kLog2A9 = 0.320598898f;
+    const float kExp2C1 = 0.693147181f;
+    const float kExp2C2 = 0.240226507f;
+    const float kExp2C3 = 0.0555041087f;
+    const float kExp2C4 = 0.00961812911f;
+    const float kExp2C5 = 0.00133335581f;
+    const float kExp2C6 = 0.000154035304f;
+    const float kExp2C7 = 1.52527338e-05f;
+
+    inline float fast_log2_1(float x)
+    {
+        if (!(x > FLT_MIN))
+            x = FLT_MIN;
+        uint32_t bits;
+        std::memcpy(&bits, &x, 4);
+        int e = static_cast<int>(bits >> 23) - 127;
+        bits = (bits & 0x7fffff) | 0x3f800000;
+        float m;
+        std::memcpy(&m, &bits, 4);
+        if (m > kSqrt2) {
+            m *= 0.5f;
+            ++e;
+        }
+        float t = (m - 1.0f) / (m + 1.0f);
+        float t2 = t * t;
+        float p = t * (kLog2A1 + t2 * (kLog2A3 + t2 * (kLog2A5 +
+                       t2 * (kLog2A7 + t2 * kLog2A9))));
+        return static_cast<float>(e) + p;
+    }
+
+    inline float fast_exp2_1(float y)
+    {
+        if (y > 127.0f)
+            y = 127.0f;
+        else if (y < -126.0f)
+            y = -126.0f;
+        int n = static_cast<int>(lrintf(y));
+        float f = y - static_cast<float>(n);
+        float p = 1.0f + f * (kExp2C1 + f * (kExp2C2 + f * (kExp2C3 +
+                  f * (kExp2C4 + f * (kExp2C5 + f * (kExp2C6 +
+                  f * kExp2C7))))));
+        uint32_t bits = static_cast<uint32_t>(n + 127) << 23;
+        float scale;
+        std::memcpy(&scale, &bits, 4);
+        return p * scale;
+    }
+}
+
+namespace {
+#if SIMDUTIL_X86
+    uint32_t detect_cpu_features()
+    {
+        uint32_t features = 0;
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        int max_leaf = info[0];
+        if (max_leaf >= 1) {
+            __cpuid(info, 1);
+            if (info[2] & (1 << 9))
+                features |= simdutil::kSSSE3;
+            /* AVX and F16C need OS support for the YMM state as well */
+            bool ymm = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+                       (_xgetbv(0) & 6) == 6;
+            if (ymm && (info[2] & (1 << 29)))
+                features |= simdutil::kF16C;
+            if (ymm && max_leaf >= 7) {
+                __cpuidex(info, 7, 0);
+                if (info[1] & (1 << 5))
+                    features |= simdutil::kAVX2;
+            }
+        }
+#else
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("ssse3"))
+            features |= simdutil::kSSSE3;
+        if (__builtin_cpu_supports("avx2"))
+            features |= simdutil::kAVX2;
+        unsigned eax, ebx, ecx, edx;
+        if (__builtin_cpu_supports("avx") &&
+            __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1 << 29)))
+            features |= simdutil::kF16C;
+#endif
+        const char *cap = std::getenv("QAAC_SIMD");
+        if (cap && !std::strcmp(cap, "none"))
+            features = 0;
+        return features;
+    }
+
+    SIMDUTIL_TARGET("avx2")
+    size_t int32_to_float_avx2(const int32_t *src, float *dst, size_t count,
+                               float scale)
+    {
+        const __m256 k = _mm256_set1_ps(scale);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), k));
+        }
+        return i;
+    }
+
+    SIMDUTIL_TARGET("avx2")
+    size_t int32_to_double_avx2(const int32_t *src, double *dst, size_t count,
+                                double scale)
+    {
+        const __m256d k = _mm256_set1_pd(scale);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+            _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_cvtepi32_pd(x), k));
+        }
+        return i;
+    }
+
+    SIMDUTIL_TARGET("avx,f16c")
+    size_t half_to_float_f16c(const uint16_t *src, float *dst, size_t count,
+                              float scale)
+    {
+        const __m256 k = _mm256_set1_ps(scale);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+            _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtph_ps(x), k));
+        }
+        return i;
+    }
+
+    SIMDUTIL_TARGET("avx2")
+    size_t double_to_float_avx2(const double *src, float *dst, size_t count)
+    {
+        const __m128 k = _mm_set1_ps(1.0e-30f);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 x = _mm256_cvtpd_ps(_mm256_loadu_pd(src + i));
+            _mm_storeu_ps(dst + i, _mm_sub_ps(_mm_add_ps(x, k), k));
+        }
+        return i;
+    }
+
+    /*
+     * Quantizer kernels: dst = lrint(clip(src * gain + noise)) << shift,
+     * computed in double like the scalar code. min/max operands are
+     * ordered so that a NaN passes through, as it does with clip().
+     */
+    inline __m128d load2_pd(const float *p)
+    {
+        return _mm_cvtps_pd(
+            _mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)p)));
+    }
+    inline __m128d load2_pd(const double *p) { return _mm_loadu_pd(p); }
+
+    template <bool Dither, typename T>
+    size_t quantize_sse2(const T *src, const float *noise, int32_t *dst,
+                         size_t count, double gain, double lo, double hi,
+                         unsigned shift)
+    {
+        const __m128d g = _mm_set1_pd(gain);
+        const __m128d vlo = _mm_set1_pd(lo);
+        const __m128d vhi = _mm_set1_pd(hi);
+        const __m128i sh = _mm_cvtsi32_si128(shift);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128d x0 = _mm_mul_pd(load2_pd(src + i), g);
+            __m128d x1 = _mm_mul_pd(load2_pd(src + i + 2), g);
+            if (Dither) {
+                x0 = _mm_add_pd(x0, load2_pd(noise + i));
+                x1 = _mm_add_pd(x1, load2_pd(noise + i + 2));
+            }
+            x0 = _mm_max_pd(vlo, _mm_min_pd(vhi, x0));
+            x1 = _mm_max_pd(vlo, _mm_min_pd(vhi, x1));
+            __m128i v = _mm_unpacklo_epi64(_mm_cvtpd_epi32(x0),
+                                           _mm_cvtpd_epi32(x1));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_sll_epi32(v, sh));
+        }
+        return i;
+    }
+
+    SIMDUTIL_TARGET("avx2")
+    inline __m256d load4_pd(const float *p)
+    {
+        return _mm256_cvtps_pd(_mm_loadu_ps(p));
+    }
+    SIMDUTIL_TARGET("avx2")
+    inline __m256d load4_pd(const double *p) { return _mm256_loadu_pd(p); }
+
+    template <bool Dither, typename T>
+    SIMDUTIL_TARGET("avx2")
+    size_t quantize_avx2(const T *src, const float *noise, int32_t *dst,
+                         size_t count, double gain, double lo, double hi,
+                         unsigned shift)
+    {
+        const __m256d g = _mm256_set1_pd(gain);
+        const __m256d vlo = _mm256_set1_pd(lo);
+        const __m256d vhi = _mm256_set1_pd(hi);
+        const __m128i sh = _mm_cvtsi32_si128(shift);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256d x0 = _mm256_mul_pd(load4_pd(src + i), g);
+            __m256d x1 = _mm256_mul_pd(load4_pd(src + i + 4), g);
+            if (Dither) {
+                x0 = _mm256_add_pd(x0, load4_pd(noise + i));
+                x1 = _mm256_add_pd(x1, load4_pd(noise + i + 4));
+            }
+            x0 = _mm256_max_pd(vlo, _mm256_min_pd(vhi, x0));
+            x1 = _mm256_max_pd(vlo, _mm256_min_pd(vhi, x1));
+            __m256i v = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm256_cvtpd_epi32(x0)),
+                _mm256_cvtpd_epi32(x1), 1);
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_sll_epi32(v, sh));
+        }
+        return i;
+    }
+
+    template <typename T>
+    size_t quantize_x86(const T *src, const float *noise, int32_t *dst,
+                        size_t count, double gain, double lo, double hi,
+                        unsigned shift)
+    {
+        bool avx2 = simdutil::cpu_features() & simdutil::kAVX2;
+        if (noise && avx2)
+            return quantize_avx2<true>(src, noise, dst, count,
+                                       gain, lo, hi, shift);
+        else if (avx2)
+            return quantize_avx2<false>(src, noise, dst, count,
+                                        gain, lo, hi, shift);
+        else if (noise)
+            return quantize_sse2<true>(src, noise, dst, count,
+                                       gain, lo, hi, shift);
+        else
+            return quantize_sse2<false>(src, noise, dst, count,
+                                        gain, lo, hi, shift);
+    }
+
+    /* same operations as fast_log2_1() and fast_exp2_1(), four at a time */
+    inline __m128 fast_log2_sse2(__m128 x)
+    {
+        x = _mm_max_ps(x, _mm_set1_ps(FLT_MIN));
+        __m128i bits = _mm_castps_si128(x);
+        __m128i e = _mm_sub_epi32(_mm_srli_epi32(bits, 23),
+                                  _mm_set1_epi32(127));
+        bits = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x7fffff)),
+                            _mm_set1_epi32(0x3f800000));
+        __m128 m = _mm_castsi128_ps(bits);
+        __m128 big = _mm_cmpgt_ps(m, _mm_set1_ps(kSqrt2));
+        m = _mm_or_ps(_mm_andnot_ps(big, m),
+                      _mm_and_ps(big, _mm_mul_ps(m, _mm_set1_ps(0.5f))));
+        e = _mm_sub_epi32(e, _mm_castps_si128(big));
+        const __m128 one = _mm_set1_ps(1.0f);
+        __m128 t = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+        __m128 t2 = _mm_mul_ps(t, t);
+        __m128 p = _mm_set1_ps(kLog2A9);
+        p = _mm_add_ps(_mm_set1_ps(kLog2A7), _mm_mul_ps(t2, p));
+        p = _mm_add_ps(_mm_set1_ps(kLog2A5), _mm_mul_ps(t2, p));
+        p = _mm_add_ps(_mm_set1_ps(kLog2A3), _mm_mul_ps(t2, p));
+        p = _mm_add_ps(_mm_set1_ps(kLog2A1), _mm_mul_ps(t2, p));
+        return _mm_add_ps(_mm_cvtepi32_ps(e), _mm_mul_ps(t, p));
+    }
+
+    inline __m128 fast_exp2_sse2(__m128 y)
+    {
+        y = _mm_max_ps(_mm_set1_ps(-126.0f),
+                       _mm_min_ps(_mm_set1_ps(127.0f), y));
+        __m128i n = _mm_cvtps_epi32(y);
+        __m128 f = _mm_sub_ps(y, _mm_cvtepi32_ps(n));
+        __m128 p = _mm_set1_ps(kExp2C7);
+        p = _mm_add_ps(_mm_set1_ps(kExp2C6), _mm_mul_ps(f, p));
+        p = _mm_add_ps(_mm_set1_ps(kExp2C5), _mm_mul_ps(f, p));
+        p = _mm_add_ps(_mm_set1_ps(kExp2C4), _mm_mul_ps(f, p));
+        p = _mm_add_ps(_mm_set1_ps(kExp2C3), _mm_mul_ps(f, p));
+        p = _mm_add_ps(_mm_set1_ps(kExp2C2), _mm_mul_ps(f, p));
+        p = _mm_add_ps(_mm_set1_ps(kExp2C1), _mm_mul_ps(f, p));
+        p = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(f, p));
+        __m128i scale = _mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)),
+                                       23);
+        return _mm_mul_ps(p, _mm_castsi128_ps(scale));
+    }
+
+    inline __m128 abs_ps(__m128 x)
+    {
+        return _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+    }
+
+    /* pshufb based kernels; each step moves one 16-byte vector */
+    SIMDUTIL_TARGET("ssse3")
+    size_t pack32to24_ssse3(void *data, size_t count)
+    {
+        const __m128i pick = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11,
+                                           13, 14, 15, -1, -1, -1, -1);
+        const uint8_t *src = static_cast<const uint8_t *>(data);
+        uint8_t *dst = static_cast<uint8_t *>(data);
+        size_t i = 0;
+        /*
+         * In place: the 4 bytes past each 12 byte result are overwritten
+         * later, or lie in the tail that has already been read.
+         */
+        for (; i + 4 <= count; i += 4) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(src + i * 4));
+            _mm_storeu_si128((__m128i *)(dst + i * 3),
+                             _mm_shuffle_epi8(x, pick));
+        }
+        return i;
+    }
+
+    SIMDUTIL_TARGET("ssse3")
+    size_t unpack24to32_ssse3(const void *input, void *output, size_t count)
+    {
+        const __m128i pick = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,
+                                           -1, 6, 7, 8, -1, 9, 10, 11);
+        const uint8_t *src = static_cast<const uint8_t *>(input);
+        uint8_t *dst = static_cast<uint8_t *>(output);
+        size_t i = 0;
+        /* loads 16 bytes for 12, so stay clear of the end of input */
+        for (; i * 3 + 16 <= count * 3; i += 4) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(src + i * 3));
+            _mm_storeu_si128((__m128i *)(dst + i * 4),
+                             _mm_shuffle_epi8(x, pick));
+        }
+        return i;
+    }
+
+    SIMDUTIL_TARGET("ssse3")
+    size_t bswap24_ssse3(uint8_t *data, size_t count)
+    {
+        /* 5 samples per vector, the 16th byte is left as is */
+        const __m128i pick = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6,
+                                           11, 10, 9, 14, 13, 12, 15);
+        size_t i = 0;
+        for (; i * 3 + 16 <= count * 3; i += 5) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(data + i * 3));
+            _mm_storeu_si128((__m128i *)(data + i * 3),
+                             _mm_shuffle_epi8(x, pick));
+        }
+        return i;
+    }
+
+    SIMDUTIL_TARGET("ssse3")
+    size_t bswap_ssse3(void *data, size_t nbytes, __m128i pick)
+    {
+        uint8_t *bp = static_cast<uint8_t *>(data);
+        size_t i = 0;
+        for (; i + 16 <= nbytes; i += 16) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(bp + i));
+            _mm_storeu_si128((__m128i *)(bp + i), _mm_shuffle_epi8(x, pick));
+        }
+        return i;
+    }
+#endif
+}
+
+namespace simdutil {
+    uint32_t cpu_features()
+    {
+#if SIMDUTIL_X86
+        /* initialized once, safe with concurrent callers */
+        static const uint32_t features = detect_cpu_features();
+        return features;
+#else
+        return 0;
+#endif
+    }
+
+    size_t int32_to_float(const int32_t *src, float *dst, size_t count,
+                          float scale)
+    {
+        size_t i = 0;
+#if SIMDUTIL_X86
+        if (cpu_features() & kAVX2)
+            return int32_to_float_avx2(src, dst, count, scale);
+        const __m128 k = _mm_set1_ps(scale);
+        for (; i + 4 <= count; i += 4) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+            _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(x), k));
+        }
+#endif
+        return i;
+    }
+
+    size_t int32_to_double(const int32_t *src, double *dst, size_t count,
+                           double scale)
+    {
+        size_t i = 0;
+#if SIMDUTIL_X86
+        if (cpu_features() & kAVX2)
+            return int32_to_double_avx2(src, dst, count, scale);
+        const __m128d k = _mm_set1_pd(scale);
+        for (; i + 2 <= count; i += 2) {
+            __m128i x = _mm_loadl_epi64((const __m128i *)(src + i));
+            _mm_storeu_pd(dst + i, _mm_mul_pd(_mm_cvtepi32_pd(x), k));
+        }
+#endif
+        return i;
+    }
+
+    size_t half_to_float(const uint16_t *src, float *dst, size_t count,
+                         float scale)
+    {
+#if SIMDUTIL_X86
+        if (cpu_features() & kF16C)
+            return half_to_float_f16c(src, dst, count, scale);
+#endif
+        return 0;
+    }
+
+    size_t double_to_float(const double *src, float *dst, size_t count)
+    {
+        size_t i = 0;
+#if SIMDUTIL_X86
+        if (cpu_features() & kAVX2)
+            return double_to_float_avx2(src, dst, count);
+        const __m128 k = _mm_set1_ps(1.0e-30f);
+        for (; i + 4 <= count; i += 4) {
+            __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(src + i));
+            __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2));
+            __m128 x = _mm_movelh_ps(lo, hi);
+            _mm_storeu_ps(dst + i, _mm_sub_ps(_mm_add_ps(x, k), k));
+        }
+#endif
+        return i;
+    }
+
+    size_t quantize(const float *src, const float *noise, int32_t *dst,
+                    size_t count, double gain, double lo, double hi,
+                    unsigned shift)
+    {
+#if SIMDUTIL_X86
+        return quantize_x86(src, noise, dst, count, gain, lo, hi, shift);
+#else
+        return 0;
+#endif
+    }
+
+    size_t quantize(const double *src, const float *noise, int32_t *dst,
+                    size_t count, double gain, double lo, double hi,
+                    unsigned shift)
+    {
+#if SIMDUTIL_X86
+        return quantize_x86(src, noise, dst, count, gain, lo, hi, shift);
+#else
+        return 0;
+#endif
+    }
+
+    size_t frame_peak(const float *src, float *dst, size_t nframes,
+                      unsigned nchannels)
+    {
+        size_t i = 0;
+#if SIMDUTIL_X86
+        const __m128 zero = _mm_setzero_ps();
+        if (nchannels == 1) {
+            for (; i + 4 <= nframes; i += 4) {
+                __m128 x = abs_ps(_mm_loadu_ps(src + i));
+                _mm_storeu_ps(dst + i, _mm_max_ps(x, zero));
+            }
+        } else if (nchannels == 2) {
+            for (; i + 4 <= nframes; i += 4) {
+                __m128 x0 = abs_ps(_mm_loadu_ps(src + i * 2));
+                __m128 x1 = abs_ps(_mm_loadu_ps(src + i * 2 + 4));
+                __m128 l = _mm_shuffle_ps(x0, x1, _MM_SHUFFLE(2, 0, 2, 0));
+                __m128 r = _mm_shuffle_ps(x0, x1, _MM_SHUFFLE(3, 1, 3, 1));
+                _mm_storeu_ps(dst + i, _mm_max_ps(r, _mm_max_ps(l, zero)));
+            }
+        }
+#endif
+        return i;
+    }
+
+    size_t scale_frames(float *data, const float *gain, size_t nframes,
+                        unsigned nchannels)
+    {
+        size_t i = 0;
+#if SIMDUTIL_X86
+        if (nchannels == 1) {
+            for (; i + 4 <= nframes; i += 4) {
+                __m128 x = _mm_loadu_ps(data + i);
+                _mm_storeu_ps(data + i, _mm_mul_ps(x, _mm_loadu_ps(gain + i)));
+            }
+        } else if (nchannels == 2) {
+            for (; i + 4 <= nframes; i += 4) {
+                __m128 g = _mm_loadu_ps(gain + i);
+                __m128 x0 = _mm_loadu_ps(data + i * 2);
+                __m128 x1 = _mm_loadu_ps(data + i * 2 + 4);
+                _mm_storeu_ps(data + i * 2,
+                              _mm_mul_ps(x0, _mm_unpacklo_ps(g, g)));
+                _mm_storeu_ps(data + i * 2 + 4,
+                              _mm_mul_ps(x1, _mm_unpackhi_ps(g, g)));
+            }
+        }
+#endif
+        return i;
+    }
+
+    void fast_log2(const float *src, float *dst, size_t count)
+    {
+        size_t i = 0;
+#if SIMDUTIL_X86
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_ps(dst + i, fast_log2_sse2(_mm_loadu_ps(src + i)));
+#endif
+        for (; i < count; ++i)
+            dst[i] = fast_log2_1(src[i]);
+    }
+
+    void fast_exp2(const float *src, float *dst, size_t count)
+    {
+        size_t i = 0;
+#if SIMDUTIL_X86
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_ps(dst + i, fast_exp2_sse2(_mm_loadu_ps(src + i)));
+#endif
+        for (; i < count; ++i)
+            dst[i] = fast_exp2_1(src[i]);
+    }
+
+    size_t pack32to16(void *data, size_t count)
+    {
+        size_t i = 0;
+#if SIMDUTIL_X86
+        const int32_t *src = static_cast<const int32_t *>(data);
+        int16_t *dst = static_cast<int16_t *>(data);
+        for (; i + 8 <= count; i += 8) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 4));
+            a = _mm_srai_epi32(a, 16);
+            b = _mm_srai_epi32(b, 16);
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(a, b));
+        }
+#endif
+        return i;
+    }
+
+    size_t pack32to24(void *data, size_t count)
+    {
+#if SIMDUTIL_X86
+        if (cpu_features() & kSSSE3)
+            return pack32to24_ssse3(data, count);
+#endif
+        return 0;
+    }
+
+    size_t unpack16to32(const void *input, void *output, size_t count)
+    {
+        size_t i = 0;
+#if SIMDUTIL_X86
+        const int16_t *src = static_cast<const int16_t *>(input);
+        int32_t *dst = static_cast<int32_t *>(output);
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 8 <= count; i += 8) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi16(zero, x));
+            _mm_storeu_si128((__m128i *)(dst + i + 4),
+                             _mm_unpackhi_epi16(zero, x));
+        }
+#endif
+        return i;
+    }
+
+    size_t unpack24to32(const void *input, void *output, size_t count)
+    {
+#if SIMDUTIL_X86
+        if (cpu_features() & kSSSE3)
+            return unpack24to32_ssse3(input, output, count);
+#endif
+        return 0;
+    }
+
+    size_t bswap16(uint16_t *data, size_t count)
+    {
+        size_t i = 0;
+#if SIMDUTIL_X86
+        for (; i + 8 <= count; i += 8) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(data + i));
+            x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+            _mm_storeu_si128((__m128i *)(data + i), x);
+        }
+#endif
+        return i;
+    }
+
+    size_t bswap24(uint8_t *data, size_t count)
+    {
+#if SIMDUTIL_X86
+        if (cpu_features() & kSSSE3)
+            return bswap24_ssse3(data, count);
+#endif
+        return 0;
+    }
+
+    size_t bswap32(uint32_t *data, size_t count)
+    {
+#if SIMDUTIL_X86
+        if (cpu_features() & kSSSE3)
+            return bswap_ssse3(data, count * 4,
+                               _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                                             11, 10, 9, 8, 15, 14, 13, 12))
+                   / 4;
+#endif
+        return 0;
+    }
+
+    size_t bswap64(uint64_t *data, size_t count)
+    {
+#if SIMDUTIL_X86
+        if (cpu_features() & kSSSE3)
+            return bswap_ssse3(data, count * 8,
+                               _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0,
+                                             15, 14, 13, 12, 11, 10, 9, 8))
+                   / 8;
+#endif
+        return 0;
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef SIMDUTIL_H
+#define SIMDUTIL_H
+
+#include <cstddef>
+#include <stdint.h>
+
+/*
+ * Vectorized sample conversions, picked at run time by CPU features.
+ * Each one handles a leading part of the input (possibly none) and
+ * returns the number of elements done; the caller finishes the rest with
+ * its scalar code. Results are bit-exact with the scalar code.
+ */
+namespace simdutil {
+    enum {
+        kSSSE3 = 1 << 0,
+        kAVX2  = 1 << 1,
+        kF16C  = 1 << 2
+    };
+    /*
+     * Set of kXXX flags usable on this machine. The environment variable
+     * QAAC_SIMD=none clears them, for testing.
+     */
+    uint32_t cpu_features();
+
+    /* dst[i] = src[i] * scale, scale being a power of two */
+    size_t int32_to_float(const int32_t *src, float *dst, size_t count,
+                          float scale);
+    size_t int32_to_double(const int32_t *src, double *dst, size_t count,
+                           double scale);
+    /*
+     * IEEE half precision, dst[i] = half(src[i]) * scale (power of two).
+     * NaNs come out quiet.
+     */
+    size_t half_to_float(const uint16_t *src, float *dst, size_t count,
+                         float scale);
+    /* narrowing, then adding and subtracting 1.0e-30f (anti denormal) */
+    size_t double_to_float(const double *src, float *dst, size_t count);
+
+    /*
+     * dst[i] = lrint(clip(src[i] * gain + noise[i], lo, hi)) << shift,
+     * evaluated in double. noise can be NULL. dst may alias src.
+     */
+    size_t quantize(const float *src, const float *noise, int32_t *dst,
+                    size_t count, double gain, double lo, double hi,
+                    unsigned shift);
+    size_t quantize(const double *src, const float *noise, int32_t *dst,
+                    size_t count, double gain, double lo, double hi,
+                    unsigned shift);
+
+    /* max |x| over the channels of each frame */
+    size_t frame_peak(const float *src, float *dst, size_t nframes,
+                      unsigned nchannels);
+    /* every channel of frame i multiplied by gain[i], in place */
+    size_t scale_frames(float *data, const float *gain, size_t nframes,
+                        unsigned nchannels);
+
+    /*
+     * Approximations of log2() and exp2(), for gain computations. These
+     * two do the whole array; vector and scalar code give the same
+     * results. Absolute error of fast_log2() and relative error of
+     * fast_exp2() are within a few float ulps (< 1e-6).
+     * fast_log2() maps zero, denormals and negatives to log2(FLT_MIN).
+     * fast_exp2() clamps its input to [-126, 127].
+     */
+    void fast_log2(const float *src, float *dst, size_t count);
+    void fast_exp2(const float *src, float *dst, size_t count);
+
+    /* top 16/24 bits of 32-bit samples, in place */
+    size_t pack32to16(void *data, size_t count);
+    size_t pack32to24(void *data, size_t count);
+    /* 16/24-bit samples into the top of 32 bits */
+    size_t unpack16to32(const void *src, void *dst, size_t count);
+    size_t unpack24to32(const void *src, void *dst, size_t count);
+
+    size_t bswap16(uint16_t *data, size_t count);
+    size_t bswap24(uint8_t *data, size_t count);
+    size_t bswap32(uint32_t *data, size_t count);
+    size_t bswap64(uint64_t *data, size_t count);
+}
+
+#endif
@@ -1,17 +1,27 @@
 #include <cstdio>
 #include <cstdarg>
 #include <vector>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 #include "util.h"
+#include "simdutil.h"
 
 namespace util {
     void bswap16buffer(uint16_t *bp, size_t size)
     {
+        size_t n = simdutil::bswap16(bp, size);
+        bp += n;
+        size -= n;
         for (uint16_t *endp = bp + size; bp != endp; ++bp)
             *bp = b2host16(*bp);
     }
 
     void bswap24buffer(uint8_t *buffer, size_t size)
     {
+        size_t n = simdutil::bswap24(buffer, size / 3) * 3;
+        buffer += n;
+        size -= n;
         for (uint8_t *p = buffer; p < buffer + size; p += 3) {
             uint8_t tmp = p[0];
             p[0] = p[2];
@@ -21,12 +31,18 @@ namespace util {
 
     void bswap32buffer(uint32_t *bp, size_t size)
     {
+        size_t n = simdutil::bswap32(bp, size);
+        bp += n;
+        size -= n;
         for (uint32_t *endp = bp + size; bp != endp; ++bp)
             *bp = b2host32(*bp);
     }
 
     void bswap64buffer(uint64_t *bp, size_t size)
     {
+        size_t n = simdutil::bswap64(bp, size);
+        bp += n;
+        size -= n;
         for (uint64_t *endp = bp + size; bp != endp; ++bp)
             *bp = b2host64(*bp);
     }
@@ -50,13 +66,13 @@ namespace util {
     }
 
     template <typename X, typename Y>
-    void packXtoY(void *data, size_t count)
+    void packXtoY(void *data, size_t count, size_t done=0)
     {
         const X *src = static_cast<X*>(data);
         Y *dst = static_cast<Y*>(data);
         const int shifts = (sizeof(X) - sizeof(Y)) * 8;
         
-        for (size_t i = 0; i < count; ++i)
+        for (size_t i = done; i < count; ++i)
             dst[i] = static_cast<Y>(src[i] >> shifts);
     }
 
@@ -68,13 +84,15 @@ namespace util {
             packXtoY<uint32_t, uint8_t>(data, *size / 4);
             *size /= 4;
         } else if (width == 4 && new_width == 2) {
-            packXtoY<uint32_t, uint16_t>(data, *size / 4);
+            packXtoY<uint32_t, uint16_t>(data, *size / 4,
+                simdutil::pack32to16(data, *size / 4));
             *size /= 2;
         } else if (width == 4 && new_width == 3) {
-            const uint8_t *src = static_cast<uint8_t*>(data);
-            uint8_t *dst = static_cast<uint8_t*>(data);
             const size_t count = *size / 4;
-            for (size_t i = 0; i < count; ++i) {
+            const size_t done = simdutil::pack32to24(data, count);
+            const uint8_t *src = static_cast<uint8_t*>(data) + done * 4;
+            uint8_t *dst = static_cast<uint8_t*>(data) + done * 3;
+            for (size_t i = done; i < count; ++i) {
                 dst[0] = src[1];
                 dst[1] = src[2];
                 dst[2] = src[3];
@@ -88,10 +106,10 @@ namespace util {
     }
 
     template <typename X, typename Y>
-    void unpackXtoY(const X *src, Y *dst, size_t count)
+    void unpackXtoY(const X *src, Y *dst, size_t count, size_t done=0)
     {
         const int shifts = (sizeof(Y) - sizeof(X)) * 8;
-        for (size_t i = 0; i < count; ++i)
+        for (size_t i = done; i < count; ++i)
             dst[i] = static_cast<Y>(src[i] << shifts);
     }
 
@@ -106,13 +124,15 @@ namespace util {
             *size *= 4;
         } else if (width == 2 && new_width == 4) {
             unpackXtoY(static_cast<const uint16_t *>(input),
-                       static_cast<uint32_t *>(output), *size / 2);
+                       static_cast<uint32_t *>(output), *size / 2,
+                       simdutil::unpack16to32(input, output, *size / 2));
             *size *= 2;
         } else if (width == 3 && new_width == 4) {
-            const uint8_t *src = static_cast<const uint8_t*>(input);
-            uint8_t *dst = static_cast<uint8_t*>(output);
             const size_t count = *size / 3;
-            for (size_t i = 0; i < count; ++i) {
+            const size_t done = simdutil::unpack24to32(input, output, count);
+            const uint8_t *src = static_cast<const uint8_t*>(input) + done * 3;
+            uint8_t *dst = static_cast<uint8_t*>(output) + done * 4;
+            for (size_t i = done; i < count; ++i) {
                 dst[0] = '\0';
                 dst[1] = src[0];
                 dst[2] = src[1];
@@ -132,6 +152,27 @@ namespace util {
             data[i] ^= 0x80000000U;
     }
 
+    uint32_t or_reduce(const uint32_t *data, size_t size)
+    {
+        uint32_t value = 0;
+        size_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+        __m128i x0 = _mm_setzero_si128(), x1 = _mm_setzero_si128();
+        for (; i + 8 <= size; i += 8) {
+            x0 = _mm_or_si128(x0, _mm_loadu_si128((const __m128i *)(data + i)));
+            x1 = _mm_or_si128(x1,
+                              _mm_loadu_si128((const __m128i *)(data + i + 4)));
+        }
+        x0 = _mm_or_si128(x0, x1);
+        x0 = _mm_or_si128(x0, _mm_srli_si128(x0, 8));
+        x0 = _mm_or_si128(x0, _mm_srli_si128(x0, 4));
+        value = _mm_cvtsi128_si32(x0);
+#endif
+        for (; i < size; ++i)
+            value |= data[i];
+        return value;
+    }
+
     ssize_t nread(int fd, void *buffer, size_t size)
     {
         char *bp = static_cast<char*>(buffer);
@@ -12,6 +12,7 @@
 #include <stdexcept>
 #include <cerrno>
 #include <memory>
+#include <vector>
 #include <stdint.h>
 #include <sys/stat.h>
 #ifdef _WIN32
@@ -87,6 +88,52 @@ namespace util {
         }
     };
 
+    /*
+     * Channel-major float samples.
+     * Every channel starts at 32 bytes aligned address.
+     */
+    class PlanarBuffer {
+        std::vector<float> m_data;
+        std::vector<float *> m_channels;
+        size_t m_capacity;
+    public:
+        PlanarBuffer(): m_capacity(0) {}
+        void resize(size_t nchannels, size_t nsamples)
+        {
+            if (nchannels == m_channels.size() && nsamples <= m_capacity)
+                return;
+            m_capacity = (nsamples + 7) & ~static_cast<size_t>(7);
+            m_data.resize(nchannels * m_capacity + 8);
+            uintptr_t addr = reinterpret_cast<uintptr_t>(&m_data[0]);
+            float *base = &m_data[((32 - (addr & 31)) & 31) / sizeof(float)];
+            m_channels.resize(nchannels);
+            for (size_t i = 0; i < nchannels; ++i)
+                m_channels[i] = base + i * m_capacity;
+        }
+        size_t channels() const { return m_channels.size(); }
+        size_t capacity() const { return m_capacity; }
+        float *channel(size_t n) { return m_channels[n]; }
+        float * const *pointers() { return &m_channels[0]; }
+        void interleave(float *dst, size_t nsamples) const
+        {
+            size_t nchannels = m_channels.size();
+            for (size_t ch = 0; ch < nchannels; ++ch) {
+                const float *src = m_channels[ch];
+                for (size_t i = 0; i < nsamples; ++i)
+                    dst[i * nchannels + ch] = src[i];
+            }
+        }
+        void deinterleave(const float *src, size_t nsamples)
+        {
+            size_t nchannels = m_channels.size();
+            for (size_t ch = 0; ch < nchannels; ++ch) {
+                float *dst = m_channels[ch];
+                for (size_t i = 0; i < nsamples; ++i)
+                    dst[i] = src[i * nchannels + ch];
+            }
+        }
+    };
+
     struct fourcc {
         uint32_t nvalue;
         char svalue[5];
@@ -198,6 +245,9 @@ namespace util {
 
     void convert_sign(uint32_t *data, size_t size);
 
+    /* bitwise OR of all the values */
+    uint32_t or_reduce(const uint32_t *data, size_t size);
+
     ssize_t nread(int fd, void *buffer, size_t size);
 
     inline double dB_to_scale(double dB)